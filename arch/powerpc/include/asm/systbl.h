@@ -356,3 +356,7 @@ COMPAT_SYS_SPU(sendmmsg)
 SYSCALL_SPU(setns)
 COMPAT_SYS(process_vm_readv)
 COMPAT_SYS(process_vm_writev)
+SYSCALL(ni_syscall)
+SYSCALL(ni_syscall)
+SYSCALL_SPU(sched_setattr)
+SYSCALL_SPU(sched_getattr)
@@ -49,6 +49,13 @@ extern void bgq_restart(char *s);
 extern void bgq_panic(char *s);
 extern int bgq_ras_puts(u32 id, const char *s);
 extern int bgq_ras_write(u32 id, const void *data, u16 len);
+
+struct bgq_ras_stat {
+	u32 id;
+	u64 sent;
+	u64 suppressed;
+};
+extern int bgq_ras_stat(unsigned slot, struct bgq_ras_stat *st);
 extern int bgq_block_state(u16 status, u32 block_id);
 
 extern u32 bgq_io_reset_block_id;
@@ -32,8 +32,6 @@
 
 #include "fusedos.h"                      // FUSEDOS
 extern fusedos_config_t* fusedos_config;  // FUSEDOS
-extern void (*spc_ipi_fp)(int, uint64_t); // FUSEDOS
-static DEFINE_SPINLOCK(bgq_ipi_lock);     // FUSEDOS
 
 static const char *bgq_pic_compat = "ibm,bgq-bic";
 
@@ -79,7 +77,6 @@ static irqreturn_t bgq_ipi_dispatch(int irq, void *dev)
 	unsigned tid = cpu_thread_in_core(cpu);
 	u64 c2c;
 	int cleared = 0;
-        unsigned long flags;    // FUSEDOS
         u64 spc_c2c_status = 0; // FUSEDOS
 
 	isum = bgq_ext_int_summary(bic->puea, tid);
@@ -99,9 +96,7 @@ static irqreturn_t bgq_ipi_dispatch(int irq, void *dev)
 	}
 	BUG_ON(!cleared);
 
-        spin_lock_irqsave(&bgq_ipi_lock, flags);                                      // FUSEDOS
-        if (spc_ipi_fp != NULL && spc_c2c_status) (*spc_ipi_fp)(cpu, spc_c2c_status); // FUSEDOS
-        spin_unlock_irqrestore(&bgq_ipi_lock, flags);                                 // FUSEDOS
+        if (spc_c2c_status) spc_ipi_dispatch(cpu, spc_c2c_status); // FUSEDOS
 
 	return smp_ipi_demux();
 }
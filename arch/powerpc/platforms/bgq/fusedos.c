@@ -21,13 +21,18 @@
 
 #include <asm/cputhreads.h>
 #include <linux/bootmem.h>
+#include <linux/cpu.h>
 #include <linux/export.h>
 #include <linux/memblock.h>
+#include <linux/mm.h>
+#include <linux/of.h>
+#include <asm-generic/sizes.h>
 
 #include "bgq.h"
 #include "bic.h"
 #include "fusedos_config.h"
 #include "fusedos.h"
+#include "personality.h"
 
 extern void spc_exception_vector(void);
 
@@ -39,6 +44,10 @@ EXPORT_SYMBOL(spc_context);
 fusedos_config_t* fusedos_config;
 EXPORT_SYMBOL(fusedos_config);
 void* spc_memory;
+static int spc_memory_nr_spcs; // SPCs spc_memory was carved out for
+static unsigned long spc_mem_size = SPC_MEMORY_SIZE; // Per SPC, from spc_mem=
+static unsigned int spc_mem_percent;                 // spc_mem=<n>% of DDR
+static unsigned long spc_mem_stride;                 // Distance between SPCs
 
 #define PHYMAP_CONST64(x) x ## LL
 #define PHYMAP_MINADDR_L1P PHYMAP_CONST64(0x3fde8000000)
@@ -61,6 +70,60 @@ static int __init nr_gpcs(char *str)
 }
 early_param("nr_gpcs", nr_gpcs);
 
+// spc_mem=<size> gives each SPC <size> bytes, spc_mem=<n>% splits n
+// percent of the DDR in the personality evenly between the SPCs
+static int __init spc_mem(char *str)
+{
+    char *end;
+    unsigned long long val = memparse(str, &end);
+
+    if (*end == '%')
+        spc_mem_percent = min_t(unsigned long long, val, 100);
+    else if (val)
+        spc_mem_size = val;
+    return 0;
+}
+early_param("spc_mem", spc_mem);
+
+static u64 __init spc_ddr_size(void)
+{
+    struct device_node *dn;
+    const struct bgq_personality *pers;
+    int len;
+    u64 size = memblock_phys_mem_size();
+
+    dn = of_find_compatible_node(NULL, NULL, "ibm,bgq-soc");
+    if (!dn)
+        return size;
+    pers = of_get_property(dn, "ibm,bgq-personality", &len);
+    if (pers && len >= sizeof(*pers))
+        size = (u64)pers->ddr_config.ddr_size_mb << 20;
+    of_node_put(dn);
+
+    return size;
+}
+
+// Size SPC memory in whole TLB extents: 1 GB pages when the per-SPC
+// size is a multiple of 1 GB, 16 MB pages otherwise.  Every SPC starts
+// on an extent boundary, so it is covered by size / extent TLB entries.
+static void __init spc_mem_size_init(void)
+{
+    int nr_spcs = fusedos_config->nr_spcs;
+    unsigned long extent;
+
+    if (spc_mem_percent && nr_spcs > 0) {
+        spc_mem_size = spc_ddr_size() * spc_mem_percent / 100 / nr_spcs;
+        spc_mem_size = round_down(spc_mem_size, SZ_16M);
+    }
+    spc_mem_size = max_t(unsigned long, round_up(spc_mem_size, SZ_16M), SZ_16M);
+
+    extent = (spc_mem_size & (SZ_1G - 1)) ? SZ_16M : SZ_1G;
+    spc_mem_stride = spc_mem_size;
+
+    fusedos_config->spc_mem_size = spc_mem_size;
+    fusedos_config->spc_mem_extent = extent;
+}
+
 void fusedos_config_init(void)
 {
     fusedos_config->nr_gpcs = NR_GPCS;
@@ -74,11 +137,16 @@ void fusedos_config_init(void)
 void spc_context_init(void)
 {
     int i;
-    int linux_cpu = 0; // Linux cpu that will handle spc interrupts
+    int linux_cpu; // Linux cpu that will handle spc interrupts
 
     for (i = 0; i < fusedos_config->nr_spcs; i++) {
+        linux_cpu = spc_ipi_cpu(i);
+
         memset((void*)(&(spc_context[i].regs)), 0, sizeof(regs_t));
 
+        spc_context[i].abi_version = SPC_CONTEXT_ABI_VERSION;
+        spc_context[i].abi_size = sizeof(spc_context_t);
+
         // Taken from bgq_cause_ipi() in bic.c
         spc_context[i].bic_int_send = (void*)(&_puea->interrupt_send);
         spc_context[i].bic_value = cpu_thread_in_core(linux_cpu) + 1;
@@ -91,11 +159,15 @@ void spc_context_init(void)
         spc_context[i].start = 0;
         spc_context[i].command = 0;
 
-        spc_context[i].mem_bot = __pa(spc_memory) + (uint64_t)(i) * (uint64_t)(SPC_MEMORY_SIZE);
+        spc_context[i].mem_bot = __pa(spc_memory) + (uint64_t)(i) * (uint64_t)(spc_mem_stride);
         //printk("FUSEDOS spc_context_init: spc_context[%d].mem_bot %016llx\n", i, spc_context[i].mem_bot);
 
         memset((void*)(spc_context[i].tlb_entry), 0, sizeof(tlb_entry_t) * MAX_TLB_ENTRIES);
         spc_context[i].tlb_entry_count = 0;
+        spc_context[i].tlb_gen = 0;
+        spc_context[i].tlb_installed_gen = 0;
+        memset(spc_context[i].tlb_dirty, 0, sizeof(spc_context[i].tlb_dirty));
+        memset(&spc_context[i].tlb_stats, 0, sizeof(spc_tlb_stats_t));
 
         memset(spc_context[i].spcm_stack, 0, SPCM_STACK_SIZE);
 
@@ -111,6 +183,8 @@ void spc_context_init(void)
         spc_context[i].ipi_message.parm1 = 0;
         spc_context[i].ipi_message.parm2 = 0;
 
+        spc_ring_init(&spc_context[i].cmd_ring);
+
         spc_context[i].text_pstart = 0;
         spc_context[i].text_pend = 0;
         spc_context[i].data_pstart = 0;
@@ -122,7 +196,7 @@ void spc_context_init(void)
         spc_context[i].scratch1 = 0;
         spc_context[i].scratch2 = 0;
         spc_context[i].scratch3 = 0;
-        memset(spc_context[i].scratch, 0, SCRATCH_SIZE);
+        memset(spc_context[i].scratch, 0, sizeof(spc_context[i].scratch));
     }
 }
 
@@ -150,11 +224,12 @@ int __init spc_memory_init(void)
     fusedos_config = (fusedos_config_t*)(__va(spc_monitor + SPC_MONITOR_SIZE + SPC_CONTEXT_SIZE));
 
     fusedos_config_init();
+    spc_mem_size_init();
 
     if( fusedos_config->nr_spcs > 0 ) {
         spc_memory = __alloc_bootmem(
-    	    ((unsigned long)SPC_MEMORY_SIZE) * (fusedos_config->nr_spcs),
-    	    PAGE_SIZE, SPC_MEMORY_PADDR);
+    	    spc_mem_stride * (fusedos_config->nr_spcs),
+    	    fusedos_config->spc_mem_extent, SPC_MEMORY_PADDR);
     
         if (__pa(spc_memory) < SPC_MEMORY_PADDR) {
             printk(KERN_ERR "FUSEDOS spc_memory_init: Cannot allocate spc_memory at 0x%x, 0x%lx\n",
@@ -162,9 +237,12 @@ int __init spc_memory_init(void)
             return -3;
         }
     }
+    spc_memory_nr_spcs = fusedos_config->nr_spcs;
     printk("FUSEDOS spc_memory_init: spc_monitor 0x%p, spc_context 0x%p, fusedos_config 0x%p\n",
            spc_monitor, spc_context, fusedos_config);
     printk("FUSEDOS spc_memory_init: spc_memory 0x%p, __pa(spc_memory) 0x%lx\n", spc_memory, __pa(spc_memory));
+    printk("FUSEDOS spc_memory_init: %lu MB per SPC in %llu MB extents\n",
+           spc_mem_size >> 20, fusedos_config->spc_mem_extent >> 20);
     printk("FUSEDOS spc_memory_init: _fw %p\n", _fw);
 
     // From firmware/src/fw_mmu.c, tlbwe_slot parameters calculated
@@ -199,12 +277,99 @@ int __init spc_memory_init(void)
     return 0;
 }
 
-void (*spc_ipi_fp)(int, uint64_t) = NULL;
-EXPORT_SYMBOL(spc_ipi_fp);
-
 //void (*upc_ipi_fp)() = NULL;
 //EXPORT_SYMBOL(upc_ipi_fp);
 
+// Set once any SPC has been handed a monitor entry point; spc_context_init()
+// clears spcm_func, so remember it across resizes
+static bool spc_launched;
+
+static bool spc_any_launched(void)
+{
+    int i;
+
+    for (i = 0; i < fusedos_config->nr_spcs; i++)
+        if (spc_context[i].spcm_func.funcaddr)
+            spc_launched = true;
+    return spc_launched;
+}
+
+// Move the GPC/SPC boundary towards the SPCs, handing SPC cores to
+// Linux.  This renumbers every remaining SPC (SPC_TO_CPU()) and
+// rebuilds its context and memory window, while a launched monitor
+// keeps polling the context it was started on; and smp_bgq_kick_cpu()
+// only works on a core still spinning in the kexec hold loop.  So the
+// boundary only moves before the first SPC is launched.  BG/Q has no
+// way to park a Linux CPU back in the hold loop (no cpu_disable/
+// cpu_die), so the SPC pool never grows after boot.  A CPU that fails
+// to come up ends the move there and the partition is committed as
+// far as it got.
+int fusedos_backend_resize(int nr_gpcs)
+{
+    int old = fusedos_config->nr_gpcs;
+    int cpu;
+    int rc = 0;
+
+    if (nr_gpcs < old)
+        return -EOPNOTSUPP;
+    if (spc_any_launched())
+        return -EBUSY;
+
+    for (cpu = old; cpu < nr_gpcs; cpu++) {
+        rc = cpu_up(cpu);
+        if (rc)
+            break;
+    }
+    if (cpu == old)
+        return rc;
+
+    NR_GPCS = cpu;
+    fusedos_config->nr_gpcs = cpu;
+    fusedos_config->nr_spcs = num_present_cpus() - cpu;
+    spc_context_init();
+
+    return rc;
+}
+
+// Shrink every SPC's memory to size and give the tail of each SPC
+// slot back to the page allocator.  There is no way back: memory
+// handed to Linux does not return to the SPC pool.
+int fusedos_backend_set_spc_mem(unsigned long size)
+{
+    unsigned long base;
+    unsigned long pfn;
+    unsigned long freed = 0;
+    int i;
+
+    size = round_up(size, SZ_16M);
+    if (size == 0 || size > spc_mem_size)
+        return -EINVAL;
+    if (size == spc_mem_size)
+        return 0;
+
+    for (i = 0; i < spc_memory_nr_spcs; i++) {
+        base = __pa(spc_memory) + i * spc_mem_stride;
+        for (pfn = PFN_DOWN(base + size); pfn < PFN_DOWN(base + spc_mem_size); pfn++) {
+            struct page *page = pfn_to_page(pfn);
+
+            ClearPageReserved(page);
+            init_page_count(page);
+            __free_page(page);
+            totalram_pages++;
+            freed++;
+        }
+    }
+
+    spc_mem_size = size;
+    fusedos_config->spc_mem_size = size;
+    if (size & (SZ_1G - 1))
+        fusedos_config->spc_mem_extent = SZ_16M;
+    pr_info("FUSEDOS: %lu MB per SPC, %lu MB returned to Linux\n",
+            size >> 20, (freed << PAGE_SHIFT) >> 20);
+
+    return 0;
+}
+
 wait_queue_head_t cl_wait_array[NR_CPUS];
 wait_queue_head_t* cl_wait = cl_wait_array;
 EXPORT_SYMBOL(cl_wait);
@@ -22,17 +22,36 @@
 #ifndef _LINUX_SPC_H_
 #define _LINUX_SPC_H_
 
-#include <asm/elf.h>
 #include <linux/types.h>
+#if defined __powerpc64__
+#include <asm/elf.h>
+#else // __powerpc64__
+// Same layout as in asm/elf.h on ppc64, for the SPC emulator
+struct ppc64_opd_entry
+{
+    unsigned long funcaddr;
+    unsigned long r2;
+};
+#endif // __powerpc64__
 
 #if !(defined __KERNEL__)
-typedef __u8 uint8_t;
-typedef __u32 uint32_t;
-typedef __u64 uint64_t;
 #include <inttypes.h>
 #include <sys/types.h>
 #endif // __KERNEL__
 
+#if defined __KERNEL__
+#include <linux/atomic.h>
+#define spc_ring_cas(p, o, n) (cmpxchg((p), (o), (n)) == (o))
+#define spc_ring_rmb()        smp_rmb()
+#define spc_ring_wmb()        smp_wmb()
+#define spc_ring_mb()         smp_mb()
+#else // __KERNEL__
+#define spc_ring_cas(p, o, n) __sync_bool_compare_and_swap((p), (o), (n))
+#define spc_ring_rmb()        __sync_synchronize()
+#define spc_ring_wmb()        __sync_synchronize()
+#define spc_ring_mb()         __sync_synchronize()
+#endif // __KERNEL__
+
 #ifndef _REGS_H_
 // From cnk/src/Regs.h
 #define NUM_GPRS (32)
@@ -88,6 +107,35 @@ typedef struct {
     uint64_t mas8;
     uint64_t mmucr3;
 } tlb_entry_t;
+#define MAX_TLB_ENTRIES 512 // 512 in cnk/src/statictlb.cc
+
+// Packed layout: the largest page that maps va to pa and fits in len,
+// as log2(bytes); MAS1 TSIZE is that minus 10.  Cover a range with
+// repeated calls to need the fewest TLB entries.
+#define SPC_TLB_NR_PAGESZ 6
+static inline int spc_tlb_chunk_shift(uint64_t va, uint64_t pa, uint64_t len)
+{
+    // Page sizes the A2 TLB supports, largest first
+    static const int shift[SPC_TLB_NR_PAGESZ] = { 30, 28, 24, 20, 16, 12 };
+    int i;
+
+    for (i = 0; i < SPC_TLB_NR_PAGESZ - 1; i++) {
+        uint64_t sz = 1ULL << shift[i];
+
+        if (!((va | pa) & (sz - 1)) && sz <= len)
+            break;
+    }
+    return shift[i];
+}
+
+// SPC-maintained TLB counters
+typedef struct {
+    uint64_t installs;      // Entries written to the TLB
+    uint64_t misses;        // TLB miss exceptions taken
+    uint64_t full_loads;    // SPC_LOAD_TLB that rewrote every entry
+    uint64_t delta_loads;   // SPC_LOAD_TLB that wrote dirty entries only
+    uint64_t skipped_loads; // SPC_LOAD_TLB with nothing to do
+} spc_tlb_stats_t;
 
 // From CoreState.h
 typedef void (*IPIHANDLER_Fcn_t)( uint64_t , uint64_t );
@@ -110,6 +158,10 @@ typedef struct FW_InternalState_t {
     // Not including node state
 } FW_InternalState_t;
 
+// Bit for SPC spc in the status word passed to spc_ipi_fp; SPC 0 is
+// the most significant bit, as decoded from the BIC C2C registers
+#define SPC_C2C_BIT(spc) (0x8000000000000000ULL >> (spc))
+
 #define SPC_IPI_QUIT    1
 #define SPC_IPI_UPCINIT 2
 typedef struct spc_IPI_Message_t {
@@ -118,46 +170,126 @@ typedef struct spc_IPI_Message_t {
     uint64_t parm2;
 } spc_IPI_Message_t;
 
+// Multi-producer command ring, drained in order by the SPC.
+// Producers (Linux and the CL) claim a slot by advancing head, fill
+// it in and publish it by storing seq = ticket + 1.  The SPC hands a
+// slot back by storing seq = ticket + SPC_RING_ENTRIES and counts
+// finished commands in done.  Post any number of commands, then ring
+// the doorbell once.
+#define SPC_RING_ENTRIES 32  // Must be a power of 2
+#define SPC_RING_LINE    128 // L2 line; head, tail and doorbell each own one
 typedef struct {
-    regs_t regs;  // Must be first so we can use CNK's REG_OFS_* defines
-    void* bic_int_send;  // &(puea->interrupt_send)
-    uint64_t bic_value;
-    volatile uint64_t ppr32;
-    volatile uint64_t ipi_wakeup;
+    volatile uint64_t seq;
+    uint64_t cmd;   // SPC_LOAD_TLB, SPC_SAVE_FPU, ...
+    uint64_t parm1;
+    uint64_t parm2;
+} spc_ring_desc_t;
 
-    uint64_t id;
-    volatile uint64_t start;
-#define SPC_START      1
-#define SPC_RESUME     2
-#define SPC_LOAD_TLB   3
-#define SPC_UNLOAD_TLB 4
-#define SPC_EXIT       5
-#define SPC_SAVE_FPU   6
-#define SPC_UPC_INIT   7
-#define SPC_UPCP_INIT  8
-    volatile uint64_t command;
+typedef struct {
+    volatile uint64_t head;     // Producers
+    char pad0[SPC_RING_LINE - 8];
+    volatile uint64_t tail;     // SPC
+    volatile uint64_t done;     // SPC
+    char pad1[SPC_RING_LINE - 16];
+    volatile uint64_t doorbell; // Set by producers, cleared by the SPC
+    char pad2[SPC_RING_LINE - 8];
+    spc_ring_desc_t desc[SPC_RING_ENTRIES];
+} __attribute__ ((aligned (SPC_RING_LINE))) spc_ring_t;
+
+static inline void spc_ring_init(spc_ring_t* r)
+{
+    int i;
+
+    r->head = 0;
+    r->tail = 0;
+    r->done = 0;
+    r->doorbell = 0;
+    for (i = 0; i < SPC_RING_ENTRIES; i++)
+        r->desc[i].seq = i;
+}
 
-    loff_t mem_bot;  // Memory bottom, set in spc_context_init
+// Returns the ticket for the command, or -1 if the ring is full
+static inline int64_t spc_ring_post(spc_ring_t* r, uint64_t cmd, uint64_t parm1, uint64_t parm2)
+{
+    uint64_t pos = r->head;
+    spc_ring_desc_t* d;
+    int64_t diff;
+
+    for (;;) {
+        d = &r->desc[pos & (SPC_RING_ENTRIES - 1)];
+        diff = (int64_t)(d->seq - pos);
+        if (diff == 0) {
+            if (spc_ring_cas(&r->head, pos, pos + 1))
+                break;
+        } else if (diff < 0) {
+            return -1;
+        }
+        pos = r->head;
+    }
+
+    d->cmd = cmd;
+    d->parm1 = parm1;
+    d->parm2 = parm2;
+    spc_ring_wmb();
+    d->seq = pos + 1;
+
+    return (int64_t)pos;
+}
 
-    volatile uint64_t tlb_entry_count;
-    volatile uint64_t tlb_entry_install;
-#define MAX_TLB_ENTRIES 512 // 512 in cnk/src/statictlb.cc
-    tlb_entry_t tlb_entry[MAX_TLB_ENTRIES];
+static inline void spc_ring_doorbell(spc_ring_t* r)
+{
+    spc_ring_wmb();
+    r->doorbell = 1;
+}
 
-#define SPCM_STACK_SIZE 1024
-    char spcm_stack[SPCM_STACK_SIZE];
+static inline int spc_ring_completed(spc_ring_t* r, uint64_t ticket)
+{
+    return (int64_t)(r->done - ticket) > 0;
+}
 
-    uint64_t spcm_sp;
-    uint64_t spcm_toc;
+// SPC side: take the next published command, returns 0 if there is none
+static inline int spc_ring_take(spc_ring_t* r, spc_ring_desc_t* out)
+{
+    uint64_t pos = r->tail;
+    spc_ring_desc_t* d = &r->desc[pos & (SPC_RING_ENTRIES - 1)];
+
+    if (d->seq != pos + 1)
+        return 0;
+    spc_ring_rmb();
+    out->cmd = d->cmd;
+    out->parm1 = d->parm1;
+    out->parm2 = d->parm2;
+    spc_ring_mb();
+    d->seq = pos + SPC_RING_ENTRIES;
+    r->tail = pos + 1;
+
+    return 1;
+}
 
-    uint64_t ex_code;
+// Context layout.  Linux, the CL and the SPC poll each other through
+// this struct, so every group of fields is owned by one writer and
+// starts on its own L2 line; the signalling words sit apart from the
+// TLB image and the scratch area.  Bump SPC_CONTEXT_ABI_VERSION when
+// the layout changes, the SPC monitor and the CL check abi_version
+// and abi_size before using a context.
+#define SPC_CONTEXT_ABI_VERSION 3
+#define SPC_CONTEXT_LINE        128 // L2 line
+#define __spc_line __attribute__ ((aligned (SPC_CONTEXT_LINE)))
 
-    struct ppc64_opd_entry spcm_func;
+typedef struct {
+    regs_t regs;  // Must be first so we can use CNK's REG_OFS_* defines
 
+    // Setup, written by Linux before the SPC is started
+    uint64_t abi_version __spc_line; // SPC_CONTEXT_ABI_VERSION
+    uint64_t abi_size;               // sizeof(spc_context_t)
+    uint64_t id;
+    void* bic_int_send;  // &(puea->interrupt_send)
+    uint64_t bic_value;
+    loff_t mem_bot;  // Memory bottom, set in spc_context_init
+    struct ppc64_opd_entry spcm_func;
+    uint64_t spcm_toc;
     int fusedosfs_fd;
 
-    volatile spc_IPI_Message_t ipi_message;
-
     uint64_t text_pstart;
     uint64_t text_pend;
     uint64_t data_pstart;
@@ -170,6 +302,50 @@ typedef struct {
     uint64_t BG_IULLAVOIDPERIOD; // IU Livelock Buster period
     uint64_t BG_IULLAVOIDDELAY;  // IU Livelock Buster delay
 
+    // Linux/CL -> SPC: command, then start
+    volatile uint64_t start __spc_line;
+#define SPC_START      1
+#define SPC_RESUME     2
+#define SPC_LOAD_TLB   3
+#define SPC_UNLOAD_TLB 4
+#define SPC_EXIT       5
+#define SPC_SAVE_FPU   6
+#define SPC_UPC_INIT   7
+#define SPC_UPCP_INIT  8
+    volatile uint64_t command;
+
+    // SPC -> Linux/CL
+    volatile uint64_t ppr32 __spc_line;
+    volatile uint64_t ipi_wakeup;
+    uint64_t ex_code;
+    uint64_t spcm_sp;
+
+    // CL -> SPC
+    volatile spc_IPI_Message_t ipi_message __spc_line;
+
+    spc_ring_t cmd_ring; // Partitioned internally
+
+    // TLB image, written by Linux/CL.  The writer of tlb_entry[] marks
+    // changed slots in tlb_dirty[tlb_gen & 1] and bumps tlb_gen; loading
+    // generation tlb_gen, the SPC writes only the slots marked in the
+    // other half, which the writer has left, or everything if
+    // tlb_installed_gen is 0 (nothing installed yet, or after
+    // SPC_UNLOAD_TLB) or more than one generation behind.  Removing an
+    // entry is writing it with MAS1[V] clear.
+    volatile uint64_t tlb_entry_count __spc_line;
+    volatile uint64_t tlb_gen;
+    uint64_t tlb_dirty[2][MAX_TLB_ENTRIES / 64] __spc_line;
+    tlb_entry_t tlb_entry[MAX_TLB_ENTRIES] __spc_line;
+
+    // TLB state, written by the SPC
+    volatile uint64_t tlb_entry_install __spc_line;
+    volatile uint64_t tlb_installed_gen;
+    spc_tlb_stats_t tlb_stats;
+
+    // SPC private
+#define SPCM_STACK_SIZE 1024
+    char spcm_stack[SPCM_STACK_SIZE] __spc_line;
+
     uint64_t scratch0;
     uint64_t scratch1;
     uint64_t scratch2;
@@ -182,13 +358,41 @@ typedef struct {
     int nr_gpcs;
     int nr_spcs;
     int fusedos_debug;
+    uint64_t spc_mem_size;   // Bytes of memory per SPC, starting at mem_bot
+    uint64_t spc_mem_extent; // TLB page size that maps SPC memory
 } fusedos_config_t;
 
+#define spc_tlb_mark_dirty(sc, slot) \
+    ((sc)->tlb_dirty[(sc)->tlb_gen & 1][(slot) / 64] |= 1ULL << ((slot) % 64))
+
+// Update one slot of the TLB image, takes effect on the next SPC_LOAD_TLB
+static inline void spc_tlb_set(spc_context_t* sc, int slot, const tlb_entry_t* e)
+{
+    sc->tlb_entry[slot] = *e;
+    spc_tlb_mark_dirty(sc, slot);
+    if ((uint64_t)slot >= sc->tlb_entry_count)
+        sc->tlb_entry_count = slot + 1;
+}
+
+static inline void spc_tlb_remove(spc_context_t* sc, int slot)
+{
+    sc->tlb_entry[slot].mas1 = 0;
+    spc_tlb_mark_dirty(sc, slot);
+}
+
+// Publish the updates made since the last commit
+static inline void spc_tlb_commit(spc_context_t* sc)
+{
+    spc_ring_wmb();
+    sc->tlb_gen++;
+}
+
 #define SPC_IOCTL_TEST     1
 #define SPC_IOCTL_INIT     2
 #define SPC_IOCTL_COMMAND  3
 #define SPC_IOCTL_IPI_QUIT 4
 #define SPC_IOCTL_WAIT_CMD 5
+#define SPC_IOCTL_RESIZE   6 // arg: new nr_gpcs
 
 #if defined __CL__
 #include <pthread.h>
@@ -218,4 +422,22 @@ extern inline __attribute__((always_inline)) fusedos_config_t* get_fusedos_confi
 #define SPC_TO_CPU(c) (c + fusedos_config->nr_gpcs)
 #endif // __CL__
 
+#if defined __KERNEL__
+// SPC interrupt fan-in, drivers/fusedos/ipi.c
+extern int spc_ipi_cpu(int spc);
+extern int spc_ipi_register(void (*fp)(int, uint64_t));
+extern void spc_ipi_unregister(void);
+extern void spc_ipi_dispatch(int cpu, uint64_t status);
+
+// GPC/SPC partition, drivers/fusedos/partition.c
+extern int fusedos_set_nr_gpcs(int nr_gpcs);
+// Provided by the SPC backend, called with no SPC commands outstanding
+extern int fusedos_backend_resize(int nr_gpcs);
+extern int fusedos_backend_set_spc_mem(unsigned long size);
+
+// /sys/kernel/fusedos/spc<N>/tlb, drivers/fusedos/tlb.c
+struct kobject;
+extern int fusedos_tlb_sysfs_init(struct kobject *parent);
+#endif // __KERNEL__
+
 #endif /* _LINUX_SPC_H_ */
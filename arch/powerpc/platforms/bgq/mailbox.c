@@ -29,6 +29,11 @@
 #include <linux/reboot.h>
 #include <linux/memblock.h>
 #include <linux/circ_buf.h>
+#include <linux/percpu.h>
+#include <linux/timer.h>
+#include <linux/hash.h>
+#include <linux/jhash.h>
+#include <linux/moduleparam.h>
 
 #include <asm/dcr.h>
 #include <asm/udbg.h>
@@ -47,6 +52,29 @@
 #define BGQ_MB_IN_WP BGQ_DCR_TI_MAILBOX_REG(2)
 #define BGQ_MB_IN_RP BGQ_DCR_TI_MAILBOX_REG(3)
 
+/*
+ * Messages are staged per cpu and copied to the outbox in batches by
+ * bgq_outbox_drain(), so producers never spin on the control system
+ * with interrupts off.  Each record is a bgq_mailbox_header followed
+ * by the payload, padded to 8 bytes; a record never wraps, the unused
+ * tail of the buffer is covered by a BGQ_OUTBOX_STAGE_PAD record.
+ * Only the owning cpu (with interrupts off) moves head, only the
+ * holder of outbox_lock moves tail.
+ */
+#define BGQ_OUTBOX_STAGE_SZ	8192
+#define BGQ_OUTBOX_STAGE_PAD	0x0000
+
+struct bgq_outbox_stage {
+	u32 head;
+	u32 tail;
+	char buf[BGQ_OUTBOX_STAGE_SZ] __aligned(16);
+};
+
+struct bgq_outbox_seg {
+	const void *buf;
+	unsigned len;
+};
+
 struct bgq_mailbox {
 	void __iomem *bedram;
 
@@ -60,9 +88,16 @@ struct bgq_mailbox {
 	void __iomem *outbox;
 	u64 outbox_sz;
 	u64 outbox_wp;
+	/* last read pointer we saw, only re-read when it looks full */
+	u64 outbox_rp;
 	/* we need to protect access to the outbox registers */
 	spinlock_t outbox_lock;
 
+	/* per-cpu staging, NULL until the drain can run */
+	struct bgq_outbox_stage __percpu *stage;
+	/* set on the way down, everything goes out synchronously */
+	int sync;
+
 	dcr_host_t dcr_ti;
 
 	struct circ_buf putc;
@@ -134,6 +169,7 @@ void __init bgq_mailbox_init(void)
 
 	/* initialize the write pointer and lock */
 	bm->outbox_wp = dcr_read64(bm->dcr_ti, BGQ_MB_OUT_WP);
+	bm->outbox_rp = dcr_read64(bm->dcr_ti, BGQ_MB_OUT_RP);
 	spin_lock_init(&bm->outbox_lock);
 
 	/* set up the inbox */
@@ -345,26 +381,225 @@ static int bgq_mailbox_in(void)
 	return rc;
 }
 
-static int bgq_mailbox_out(u16 cmd, const void *buf, u16 sz)
+/* is there room for len more bytes, only asks the hardware when needed */
+static int bgq_outbox_fits(struct bgq_mailbox *bm, ulong len)
+{
+	if (bm->outbox_wp + len - bm->outbox_rp <= bm->outbox_sz)
+		return 1;
+	bm->outbox_rp = dcr_read64(bm->dcr_ti, BGQ_MB_OUT_RP);
+	return bm->outbox_wp + len - bm->outbox_rp <= bm->outbox_sz;
+}
+
+/*
+ * Copy one message into the outbox at outbox_wp.  The caller holds
+ * outbox_lock, has checked the space and calls bgq_outbox_publish()
+ * once it is done with the batch.
+ */
+static void bgq_outbox_copy(struct bgq_mailbox *bm, u16 cmd, u16 thread_id,
+			    const struct bgq_outbox_seg *seg, int nseg, u16 sz)
 {
-	struct bgq_mailbox *bm = &mbox;
 	struct bgq_mailbox_header __iomem *mp;
-	u64 rp;
-	u64 wp;
-	ulong flags;
-	ulong len;
-	unsigned space;
 	unsigned woff;
+	unsigned space;
+	unsigned n;
+	int i;
 
-	if (!bm->outbox)
-		return -ENODEV;
+	woff = bm->outbox_wp & (bm->outbox_sz - 1);
+	mp = bm->outbox + woff;
 
-	if (sz == 0)
-		return 0;
+	/*
+	 * since mp is always aligned at 16 bytes we can freely write
+	 * the header
+	 */
+	mp->cmd = cmd;
+	mp->payload_len = sz;
+	mp->thread_id = thread_id;
+	mp->crc = 0;
+
+	woff += sizeof(*mp);
+
+	for (i = 0; i < nseg; i++) {
+		n = seg[i].len;
+		woff &= bm->outbox_sz - 1;
+		if (woff + n > bm->outbox_sz) {
+			space = bm->outbox_sz - woff;
+			memcpy(bm->outbox + woff, seg[i].buf, space);
+			memcpy(bm->outbox, seg[i].buf + space, n - space);
+		} else {
+			memcpy(bm->outbox + woff, seg[i].buf, n);
+		}
+		woff += n;
+	}
 
-	len = sizeof(*mp) + sz;
 	/* commands are always aligned to 16 bytes */
-	len = round_up(len, 0x10);
+	bm->outbox_wp += round_up(sizeof(*mp) + sz, 0x10);
+}
+
+static void bgq_outbox_publish(struct bgq_mailbox *bm)
+{
+	iobarrier_w();
+	dcr_write64(bm->dcr_ti, BGQ_MB_OUT_WP, bm->outbox_wp);
+}
+
+/*
+ * Move what cpu has staged to the outbox, in order.  Without wait we
+ * stop when the outbox is full and return non-zero so the caller can
+ * try again later.
+ */
+static int bgq_outbox_stage_drain(struct bgq_mailbox *bm,
+				  struct bgq_outbox_stage *st, int wait)
+{
+	struct bgq_mailbox_header *h;
+	struct bgq_outbox_seg seg;
+	u32 head;
+	u32 tail;
+	unsigned off;
+
+	head = ACCESS_ONCE(st->head);
+	tail = st->tail;
+	/* read index before reading contents at that index */
+	smp_rmb();
+
+	while (tail != head) {
+		off = tail & (BGQ_OUTBOX_STAGE_SZ - 1);
+		h = (struct bgq_mailbox_header *)&st->buf[off];
+
+		if (h->cmd == BGQ_OUTBOX_STAGE_PAD) {
+			tail += BGQ_OUTBOX_STAGE_SZ - off;
+		} else {
+			if (!bgq_outbox_fits(bm, round_up(sizeof(*h) +
+							  h->payload_len,
+							  0x10))) {
+				if (!wait)
+					break;
+				/*
+				 * wait for control system to catch up
+				 * can't sleep because we may be in interrupt
+				 */
+				udelay(10);
+				continue;
+			}
+			seg.buf = h->data;
+			seg.len = h->payload_len;
+			bgq_outbox_copy(bm, h->cmd, h->thread_id, &seg, 1,
+					h->payload_len);
+			tail += round_up(sizeof(*h) + h->payload_len, 8);
+		}
+		/* finish reading the record before handing it back */
+		smp_mb();
+		ACCESS_ONCE(st->tail) = tail;
+	}
+
+	return tail != head;
+}
+
+static void bgq_outbox_drain(unsigned long data);
+
+static DECLARE_TASKLET(bgq_outbox_tasklet, bgq_outbox_drain, 0);
+static DEFINE_TIMER(bgq_outbox_timer, bgq_outbox_drain, 0, 0);
+
+/*
+ * Batched drain: one DCR write of the write pointer for everything
+ * that fits, retried from a timer while the control system is behind.
+ */
+static void bgq_outbox_drain(unsigned long data)
+{
+	struct bgq_mailbox *bm = &mbox;
+	u64 wp;
+	ulong flags;
+	int pending = 0;
+	int cpu;
+
+	spin_lock_irqsave(&bm->outbox_lock, flags);
+	wp = bm->outbox_wp;
+	for_each_possible_cpu(cpu)
+		pending |= bgq_outbox_stage_drain(bm,
+						  per_cpu_ptr(bm->stage, cpu), 0);
+	if (bm->outbox_wp != wp)
+		bgq_outbox_publish(bm);
+	spin_unlock_irqrestore(&bm->outbox_lock, flags);
+
+	if (pending)
+		mod_timer(&bgq_outbox_timer, jiffies + 1);
+}
+
+/* append to this cpu's staging buffer, -ENOSPC if it does not fit */
+static int bgq_outbox_stage(struct bgq_mailbox *bm, u16 cmd,
+			    const struct bgq_outbox_seg *seg, int nseg, u16 sz)
+{
+	struct bgq_outbox_stage *st;
+	struct bgq_mailbox_header *h;
+	ulong flags;
+	unsigned rlen;
+	unsigned pad;
+	unsigned off;
+	u32 head;
+	u32 tail;
+	char *p;
+	int i;
+
+	rlen = round_up(sizeof(*h) + sz, 8);
+	if (rlen > BGQ_OUTBOX_STAGE_SZ)
+		return -ENOSPC;
+
+	local_irq_save(flags);
+	st = this_cpu_ptr(bm->stage);
+
+	head = st->head;
+	tail = ACCESS_ONCE(st->tail);
+	off = head & (BGQ_OUTBOX_STAGE_SZ - 1);
+	pad = 0;
+	if (off + rlen > BGQ_OUTBOX_STAGE_SZ)
+		pad = BGQ_OUTBOX_STAGE_SZ - off;
+
+	if (pad + rlen > BGQ_OUTBOX_STAGE_SZ - (head - tail)) {
+		local_irq_restore(flags);
+		return -ENOSPC;
+	}
+
+	if (pad) {
+		h = (struct bgq_mailbox_header *)&st->buf[off];
+		h->cmd = BGQ_OUTBOX_STAGE_PAD;
+		head += pad;
+		off = 0;
+	}
+
+	h = (struct bgq_mailbox_header *)&st->buf[off];
+	h->cmd = cmd;
+	h->payload_len = sz;
+	h->thread_id = hard_smp_processor_id();
+	h->crc = 0;
+	p = h->data;
+	for (i = 0; i < nseg; i++) {
+		memcpy(p, seg[i].buf, seg[i].len);
+		p += seg[i].len;
+	}
+
+	/* commit the record before moving the head */
+	smp_wmb();
+	st->head = head + rlen;
+	local_irq_restore(flags);
+
+	tasklet_schedule(&bgq_outbox_tasklet);
+
+	return sz;
+}
+
+/*
+ * Synchronous path: flush everything staged so far and then write
+ * this message, spinning until the control system makes room.  Used
+ * before the staging buffers exist, on the way down, and when a
+ * producer has filled its staging buffer.
+ */
+static int bgq_mailbox_outv(u16 cmd, const struct bgq_outbox_seg *seg,
+			    int nseg, u16 sz)
+{
+	struct bgq_mailbox *bm = &mbox;
+	ulong flags;
+	ulong len;
+	int cpu;
+
+	len = round_up(sizeof(struct bgq_mailbox_header) + sz, 0x10);
 
 	/*
 	 * we need to preserve the order of messages so there is no
@@ -373,55 +608,86 @@ static int bgq_mailbox_out(u16 cmd, const void *buf, u16 sz)
 	 */
 	spin_lock_irqsave(&bm->outbox_lock, flags);
 
-	wp = bm->outbox_wp;
-	for (;;) {
-		rp = dcr_read64(bm->dcr_ti, BGQ_MB_OUT_RP);
-
-		space = wp + len - rp;
-		if (space > bm->outbox_sz) {
-			/*
-			 * wait for control system to catch up
-			 * can't sleep because we may be in interrupt
-			 */
-			udelay(10);
-			continue;
-		}
-		break;
+	if (bm->stage)
+		for_each_possible_cpu(cpu)
+			bgq_outbox_stage_drain(bm, per_cpu_ptr(bm->stage, cpu),
+					       1);
+
+	while (!bgq_outbox_fits(bm, len)) {
+		/*
+		 * wait for control system to catch up
+		 * can't sleep because we may be in interrupt
+		 */
+		udelay(10);
 	}
 
-	woff = wp & (bm->outbox_sz - 1);
-	mp = bm->outbox + woff;
+	bgq_outbox_copy(bm, cmd, hard_smp_processor_id(), seg, nseg, sz);
+	bgq_outbox_publish(bm);
 
-	/*
-	 * since mp is always aligned at 16 bytes we can freely write
-	 * the header
-	 */
-	mp->cmd = cmd;
-	mp->payload_len = sz;
-	mp->thread_id = hard_smp_processor_id();
-	mp->crc = 0;
+	spin_unlock_irqrestore(&bm->outbox_lock, flags);
 
-	woff += sizeof(*mp);
+	return sz;
+}
 
-	if (woff + sz > bm->outbox_sz) {
-		space = bm->outbox_sz - woff;
-		memcpy(mp->data, buf, space);
-		memcpy(bm->outbox, buf + space, sz - space);
-	} else {
-		memcpy(mp->data, buf, sz);
+static int bgq_outbox_post(u16 cmd, const struct bgq_outbox_seg *seg,
+			   int nseg)
+{
+	struct bgq_mailbox *bm = &mbox;
+	unsigned sz = 0;
+	int rc;
+	int i;
+
+	if (!bm->outbox)
+		return -ENODEV;
+
+	for (i = 0; i < nseg; i++)
+		sz += seg[i].len;
+	if (sz == 0)
+		return 0;
+
+	if (bm->stage && !bm->sync && !oops_in_progress) {
+		rc = bgq_outbox_stage(bm, cmd, seg, nseg, sz);
+		if (rc >= 0)
+			return rc;
 	}
 
-	iobarrier_w();
+	return bgq_mailbox_outv(cmd, seg, nseg, sz);
+}
+
+static int bgq_mailbox_out(u16 cmd, const void *buf, u16 sz)
+{
+	struct bgq_outbox_seg seg = { .buf = buf, .len = sz };
 
-	wp += len;
+	if (!mbox.outbox)
+		return -ENODEV;
 
-	bm->outbox_wp = wp;
-	dcr_write64(bm->dcr_ti, BGQ_MB_OUT_WP, wp);
+	if (sz == 0)
+		return 0;
 
-	spin_unlock_irqrestore(&bm->outbox_lock, flags);
+	return bgq_mailbox_outv(cmd, &seg, 1, sz);
+}
 
-	return sz;
+static int __init bgq_outbox_stage_init(void)
+{
+	struct bgq_mailbox *bm = &mbox;
+	struct bgq_outbox_stage __percpu *stage;
+
+	if (!bm->outbox)
+		return 0;
+
+	stage = alloc_percpu(struct bgq_outbox_stage);
+	if (!stage) {
+		pr_warn("%s: no staging buffers, outbox stays synchronous\n",
+			__func__);
+		return -ENOMEM;
+	}
+
+	/* buffers are zeroed before anybody can see them */
+	smp_wmb();
+	bm->stage = stage;
+	return 0;
 }
+core_initcall(bgq_outbox_stage_init);
 
 static void bgq_outbox_terminate(u32 status)
 {
@@ -458,6 +724,7 @@ void bgq_send_ras_termination(int status) {
 
 void bgq_halt(void)
 {
+	mbox.sync = 1;
 	bgq_mailbox_out(BGQ_OUTBOX_STDOUT, __func__, sizeof(__func__) - 1);
 	bgq_outbox_terminate(0);
 	for (;;)
@@ -466,6 +733,7 @@ void bgq_halt(void)
 
 void bgq_restart(char *s)
 {
+	mbox.sync = 1;
 	bgq_mailbox_out(BGQ_OUTBOX_STDOUT, __func__, sizeof(__func__) - 1);
 	if (s)
 		bgq_mailbox_out(BGQ_OUTBOX_STDOUT, s, strlen(s));
@@ -476,27 +744,214 @@ void bgq_restart(char *s)
 
 #define	BGQ_OUTBOX_RAS_KERNEL_PANIC		 0xa000d
 
+/*
+ * RAS rate limiting.  A fault storm (ECC, link retrains) can raise the
+ * same event thousands of times a second; the control system only
+ * needs to hear about it a few times.  Per RAS id we send at most
+ * bgq_ras_burst events every bgq_ras_interval_ms, and an event that
+ * is identical to the last one sent for its id in the same interval
+ * is coalesced into it.  Everything else is counted as suppressed and
+ * reported in /proc/bgq_ras, and per interval in the kernel log once
+ * the interval is over.  Nothing is limited on the way down.
+ */
+#define BGQ_RAS_LIMIT_BITS	6
+#define BGQ_RAS_LIMIT_SLOTS	(1 << BGQ_RAS_LIMIT_BITS)
+
+struct bgq_ras_limit {
+	u32 id;			/* 0 means the slot is free */
+	u32 last;		/* hash of the last event sent */
+	ulong window;		/* jiffies the interval started */
+	unsigned nr;		/* sent in this interval */
+	unsigned dropped;	/* suppressed in this interval */
+	u64 sent;
+	u64 suppressed;
+};
+
+static struct bgq_ras_limit bgq_ras_limit[BGQ_RAS_LIMIT_SLOTS];
+static DEFINE_SPINLOCK(bgq_ras_limit_lock);
+
+static unsigned bgq_ras_burst = 10;	/* 0 means no limit */
+static unsigned bgq_ras_interval_ms = 1000;
+core_param(bgq_ras_burst, bgq_ras_burst, uint, 0644);
+core_param(bgq_ras_interval_ms, bgq_ras_interval_ms, uint, 0644);
+
+static void bgq_ras_flush(unsigned long data);
+
+static DEFINE_TIMER(bgq_ras_flush_timer, bgq_ras_flush, 0, 0);
+static int bgq_ras_timer_ready;
+
+/* NULL when the table is full, then the id is not limited */
+static struct bgq_ras_limit *bgq_ras_limit_slot(u32 id)
+{
+	struct bgq_ras_limit *rl;
+	unsigned i;
+	unsigned n;
+
+	i = hash_32(id, BGQ_RAS_LIMIT_BITS);
+	for (n = 0; n < BGQ_RAS_LIMIT_SLOTS; n++) {
+		rl = &bgq_ras_limit[(i + n) & (BGQ_RAS_LIMIT_SLOTS - 1)];
+		if (rl->id == id)
+			return rl;
+		if (rl->id == 0) {
+			rl->id = id;
+			rl->window = jiffies;
+			return rl;
+		}
+	}
+	return NULL;
+}
+
+static ulong bgq_ras_window_end(struct bgq_ras_limit *rl)
+{
+	return rl->window + msecs_to_jiffies(bgq_ras_interval_ms);
+}
+
+/* Called with bgq_ras_limit_lock held, starts a new interval if due */
+static void bgq_ras_limit_expire(struct bgq_ras_limit *rl)
+{
+	if (!time_after(jiffies, bgq_ras_window_end(rl)))
+		return;
+
+	if (rl->dropped)
+		pr_warn("%s: RAS 0x%x: %u events suppressed\n",
+			__func__, rl->id, rl->dropped);
+	rl->window = jiffies;
+	rl->nr = 0;
+	rl->dropped = 0;
+}
+
+/*
+ * Report the events suppressed in intervals that are over, even if
+ * their id is never raised again, and come back for the ones that
+ * are not over yet.
+ */
+static void bgq_ras_flush(unsigned long data)
+{
+	struct bgq_ras_limit *rl;
+	ulong flags;
+	ulong next = 0;
+	int pending = 0;
+	unsigned i;
+
+	spin_lock_irqsave(&bgq_ras_limit_lock, flags);
+	for (i = 0; i < BGQ_RAS_LIMIT_SLOTS; i++) {
+		rl = &bgq_ras_limit[i];
+		if (!rl->id || !rl->dropped)
+			continue;
+		bgq_ras_limit_expire(rl);
+		if (!rl->dropped)
+			continue;
+		if (!pending || time_before(bgq_ras_window_end(rl), next))
+			next = bgq_ras_window_end(rl);
+		pending = 1;
+	}
+	if (pending && bgq_ras_timer_ready)
+		mod_timer(&bgq_ras_flush_timer, next + 1);
+	spin_unlock_irqrestore(&bgq_ras_limit_lock, flags);
+}
+
+/* RAS events can be raised before timers work, flush those from here */
+static int __init bgq_ras_flush_init(void)
+{
+	bgq_ras_timer_ready = 1;
+	bgq_ras_flush(0);
+	return 0;
+}
+core_initcall(bgq_ras_flush_init);
+
+/* returns non-zero if the event should go to the control system */
+static int bgq_ras_allow(u32 id, const void *data, unsigned len)
+{
+	struct bgq_ras_limit *rl;
+	ulong flags;
+	u32 h;
+	int rc = 1;
+
+	h = jhash(data, len, id);
+
+	spin_lock_irqsave(&bgq_ras_limit_lock, flags);
+	rl = bgq_ras_limit_slot(id);
+	if (!rl)
+		goto out;
+
+	if (mbox.sync || oops_in_progress || bgq_ras_burst == 0)
+		goto sent;
+
+	bgq_ras_limit_expire(rl);
+
+	if ((rl->nr > 0 && rl->last == h) || rl->nr >= bgq_ras_burst) {
+		ulong end = bgq_ras_window_end(rl) + 1;
+
+		if (!rl->dropped++ && bgq_ras_timer_ready &&
+		    (!timer_pending(&bgq_ras_flush_timer) ||
+		     time_before(end, bgq_ras_flush_timer.expires)))
+			mod_timer(&bgq_ras_flush_timer, end);
+		rl->suppressed++;
+		rc = 0;
+		goto out;
+	}
+	rl->nr++;
+sent:
+	rl->last = h;
+	rl->sent++;
+out:
+	spin_unlock_irqrestore(&bgq_ras_limit_lock, flags);
+
+	return rc;
+}
+
+/* for /proc/bgq_ras, returns 0 for an unused slot */
+int bgq_ras_stat(unsigned slot, struct bgq_ras_stat *st)
+{
+	struct bgq_ras_limit *rl;
+	ulong flags;
+	int rc = 0;
+
+	if (slot >= BGQ_RAS_LIMIT_SLOTS)
+		return -ENOENT;
+
+	rl = &bgq_ras_limit[slot];
+	spin_lock_irqsave(&bgq_ras_limit_lock, flags);
+	if (rl->id) {
+		st->id = rl->id;
+		st->sent = rl->sent;
+		st->suppressed = rl->suppressed;
+		rc = 1;
+	}
+	spin_unlock_irqrestore(&bgq_ras_limit_lock, flags);
+
+	return rc;
+}
+EXPORT_SYMBOL(bgq_ras_stat);
+
 int bgq_ras_puts(u32 id, const char *s)
 {
 	struct ras {
 		u64 uci;
 		u32 id;
 		char msg[4];	/* should be 0 but we claim the pad */
-	} *r;
+	} r;
+	struct bgq_outbox_seg seg[3];
 	unsigned l = strlen(s);
-	unsigned sz;
 
 	if (l >  BGQ_OUTBOX_RAS_MAX)
 		l =  BGQ_OUTBOX_RAS_MAX;
-	sz = sizeof(*r) - sizeof(r->msg) + l;
 
-	r = __builtin_alloca(sz);
+	if (!bgq_ras_allow(id, s, l))
+		return 0;
 
-	r->uci = 0;
-	r->id = id;
-	strlcpy(r->msg, s, l);
+	r.uci = 0;
+	r.id = id;
 
-	return bgq_mailbox_out(BGQ_OUTBOX_RAS_ASCII, r, sz);
+	/* the message goes out straight from s, NUL terminated at l */
+	seg[0].buf = &r;
+	seg[0].len = offsetof(struct ras, msg);
+	seg[1].buf = s;
+	seg[1].len = l ? l - 1 : 0;
+	seg[2].buf = "";
+	seg[2].len = l ? 1 : 0;
+
+	return bgq_outbox_post(BGQ_OUTBOX_RAS_ASCII, seg, 3);
 }
 EXPORT_SYMBOL(bgq_ras_puts);
 
@@ -508,28 +963,33 @@ int bgq_ras_write(u32 id, const void *data, u16 len)
 		u16 _res;
 		u16 num_details;	/* number of 64bit words in details */
 		u64 details[0];
-	} *r;
-	unsigned sz;
-	const unsigned lmax = BGQ_OUTBOX_RAS_MAX / sizeof(r->details[0]);
+	} r;
+	struct bgq_outbox_seg seg[2];
+	const unsigned lmax = BGQ_OUTBOX_RAS_MAX / sizeof(r.details[0]);
 
 	if (len > lmax)
 		len = lmax;
 
-	sz = sizeof(*r) + (len * sizeof(r->details[0]));
-	r = __builtin_alloca(sz);
+	if (!bgq_ras_allow(id, data, len * sizeof(r.details[0])))
+		return 0;
 
-	r->uci = 0;
-	r->id = id;
-	r->_res = 0;
-	r->num_details = len;
-	memcpy(r->details, data, (len * sizeof(r->details[0])));
+	r.uci = 0;
+	r.id = id;
+	r._res = 0;
+	r.num_details = len;
 
-	return bgq_mailbox_out(BGQ_OUTBOX_RAS_BINARY, r, sz);
+	seg[0].buf = &r;
+	seg[0].len = sizeof(r);
+	seg[1].buf = data;
+	seg[1].len = len * sizeof(r.details[0]);
+
+	return bgq_outbox_post(BGQ_OUTBOX_RAS_BINARY, seg, 2);
 }
 EXPORT_SYMBOL(bgq_ras_write);
 
 void bgq_panic(char *s)
 {
+	mbox.sync = 1;
 	bgq_mailbox_out(BGQ_OUTBOX_STDERR, __func__, sizeof(__func__) - 1);
 	bgq_mailbox_out(BGQ_OUTBOX_STDERR, s, strlen(s));
 	bgq_ras_puts(BGQ_OUTBOX_RAS_KERNEL_PANIC, s);
@@ -553,7 +1013,9 @@ int bgq_block_state(u16 status, u32 block_id)
 		.timestamp = get_tb(),
 	};
 
-	return bgq_mailbox_out(BGQ_OUTBOX_BLOCK_STATE, &sb, sizeof(sb));
+	struct bgq_outbox_seg seg = { .buf = &sb, .len = sizeof(sb) };
+
+	return bgq_outbox_post(BGQ_OUTBOX_BLOCK_STATE, &seg, 1);
 }
 EXPORT_SYMBOL(bgq_block_state);
 
@@ -574,25 +1036,15 @@ static void bgq_stdout_flush(void)
 	/* read index before reading contents at that index */
 	smp_read_barrier_depends();
 	if (sz > 0) {
-		if (tail + sz > bm->putc_sz) {
-			unsigned space = bm->putc_sz - tail;
-			char *tmp;
+		struct bgq_outbox_seg seg[2];
 
-			if (sz - space > bm->putc_sz)
-				bgq_panic("buffer too big\n");
-			/*
-			 * we copy it into a temp buffer so we can get
-			 * it out all as one line
-			 */
-			tmp = __builtin_alloca(sz);
-			memcpy(tmp, &bm->putc.buf[tail], space);
-			memcpy(tmp + space, &bm->putc.buf[0], sz - space);
-
-			bgq_mailbox_out(BGQ_OUTBOX_STDOUT, tmp, sz);
-		} else {
-			bgq_mailbox_out(BGQ_OUTBOX_STDOUT,
-					&bm->putc.buf[tail], sz);
-		}
+		/* a wrapped line goes out as one message in two pieces */
+		seg[0].buf = &bm->putc.buf[tail];
+		seg[0].len = min_t(unsigned, sz, bm->putc_sz - tail);
+		seg[1].buf = &bm->putc.buf[0];
+		seg[1].len = sz - seg[0].len;
+
+		bgq_outbox_post(BGQ_OUTBOX_STDOUT, seg, 2);
 		/* finish reading descriptor before incrementing tail */
 		smp_mb();
 		bm->putc.tail = (tail + sz) & (bm->putc_sz - 1);
@@ -144,6 +144,43 @@ struct bgq_personality {
 	struct bgq_personality_ethernet ethernet_config;
 };
 
+/**
+ * struct bgq_personality_image - read-only mmap of /dev/bgpers
+ * @magic: BGQ_PERS_IMAGE_MAGIC
+ * @version: BGQ_PERS_IMAGE_VERSION
+ * @size: bytes in the image, the mapping is rounded up to a page
+ * @nr_keys: entries in the key index
+ * @index_off: offset of the struct bgq_personality_key index
+ * @text_off: offset of the KEY=value lines read(2) returns
+ * @text_len: bytes of text
+ * &pers: the raw personality as the firmware passed it
+ *
+ * The index is sorted by name (memcmp, then length), so a reader can
+ * bsearch for BG_NODE_COORDS and friends without parsing the text.
+ * Name and value offsets are from the start of the image and are not
+ * NUL terminated; quotes around values are not part of the value.
+ */
+#define BGQ_PERS_IMAGE_MAGIC	0x42475045	/* "BGPE" */
+#define BGQ_PERS_IMAGE_VERSION	1
+struct bgq_personality_key {
+	u32 name_off;
+	u32 val_off;
+	u16 name_len;
+	u16 val_len;
+};
+
+struct bgq_personality_image {
+	u32 magic;
+	u32 version;
+	u32 size;
+	u32 nr_keys;
+	u32 index_off;
+	u32 text_off;
+	u32 text_len;
+	u32 _pad;
+	struct bgq_personality pers;
+};
+
 /* bit codes for kernel.node_config */
 #define FW_BIT(b) (1ULL << (63 - (b)))
 #define PERS_ENABLE_MMU			FW_BIT(0)
@@ -128,6 +128,20 @@ static noinline int gup_huge_pmd(pmd_t pmd, unsigned long addr,
 	refs = 0;
 	head = pte_page(pte);
 	page = head + ((addr & ~PMD_MASK) >> PAGE_SHIFT);
+	if (!PageHead(head)) {
+		/*
+		 * A shmem team: its subpages are independent page cache
+		 * pages, referenced one by one as if mapped by ptes.
+		 */
+		do {
+			get_page(page);
+			SetPageReferenced(page);
+			pages[*nr] = page;
+			(*nr)++;
+			page++;
+		} while (addr += PAGE_SIZE, addr != end);
+		return 1;
+	}
 	do {
 		VM_BUG_ON(compound_head(page) != head);
 		pages[*nr] = page;
@@ -22,12 +22,14 @@
 #include <linux/module.h>
 #include <linux/miscdevice.h>
 #include <linux/fs.h>
-#include <linux/seq_file.h>
 #include <linux/ctype.h>
 #include <linux/slab.h>
 #include <linux/uaccess.h>
 #include <linux/list.h>
 #include <linux/of.h>
+#include <linux/mm.h>
+#include <linux/gfp.h>
+#include <linux/sort.h>
 
 #include <platforms/bgq/personality.h>
 
@@ -137,6 +139,14 @@ struct bgq_pers_el {
 
 static LIST_HEAD(bgq_pers_list);
 
+/*
+ * The list is only used to build the image at init time: the raw
+ * personality, a sorted key index and the text, in one page-aligned
+ * buffer that read(2) copies from and mmap(2) maps read-only.
+ */
+static struct bgq_personality_image *bgq_pers_image;
+static size_t bgq_pers_image_sz;
+
 #define BGQ_UCI_COMPONENT_COMPUTE_CARD_ON_NODE_BOARD			13
 #define BGQ_UCI_COMPONENT_COMPUTE_CARD_ON_IO_BOARD_ON_COMPUTE_RACK	30
 #define MASK(s, e) ((~0ULL << (63 - (e))) & (~0ULL >> (s)))
@@ -650,59 +660,130 @@ static int bgq_pers_make_list(unsigned ents, struct bgq_config *lc,
 static void bgq_pers_free_list(void)
 {
 	struct bgq_pers_el *el;
+	struct bgq_pers_el *tmp;
 
-	list_for_each_entry(el, &bgq_pers_list, list) {
+	list_for_each_entry_safe(el, tmp, &bgq_pers_list, list) {
 		list_del(&el->list);
 		kfree(el);
 	}
 }
 
-/* Functions for seqential access of the bgpers structure */
-static void *bgq_persdev_seq_start(struct seq_file *f, loff_t *pos)
+static int __init bgq_pers_key_cmp(const void *a, const void *b)
 {
-	return seq_list_start(&bgq_pers_list, *pos);
-}
+	const struct bgq_personality_key *ka = a;
+	const struct bgq_personality_key *kb = b;
+	const char *base = (const char *)bgq_pers_image;
+	int rc;
 
-static void *bgq_persdev_seq_next(struct seq_file *f, void *v, loff_t *pos)
-{
-	return seq_list_next(v, &bgq_pers_list, pos);
+	rc = memcmp(base + ka->name_off, base + kb->name_off,
+		    min(ka->name_len, kb->name_len));
+	if (rc)
+		return rc;
+	return ka->name_len - kb->name_len;
 }
 
-static void bgq_persdev_seq_stop(struct seq_file *f, void *v)
+static int __init bgq_pers_make_image(struct bgq_personality *p)
 {
-	return;
-}
+	struct bgq_personality_image *im;
+	struct bgq_personality_key *key;
+	struct bgq_pers_el *el;
+	unsigned nr = 0;
+	size_t text_len = 0;
+	size_t sz;
+	char *text;
+	char *line;
+	char *eq;
+	char *nl;
+	size_t len;
 
-static int bgq_persdev_seq_show(struct seq_file *f, void *v)
-{
-	const struct bgq_pers_el *el;
+	list_for_each_entry(el, &bgq_pers_list, list) {
+		text_len += strlen(el->line);
+		nr++;
+	}
+
+	sz = sizeof(*im) + nr * sizeof(*key) + text_len;
+	im = alloc_pages_exact(PAGE_ALIGN(sz), GFP_KERNEL | __GFP_ZERO);
+	if (!im)
+		return -ENOMEM;
+
+	im->magic = BGQ_PERS_IMAGE_MAGIC;
+	im->version = BGQ_PERS_IMAGE_VERSION;
+	im->size = sz;
+	im->index_off = sizeof(*im);
+	im->text_off = sizeof(*im) + nr * sizeof(*key);
+	im->text_len = text_len;
+	memcpy(&im->pers, p, sizeof(*p));
+
+	key = (void *)im + im->index_off;
+	text = (char *)im + im->text_off;
+	list_for_each_entry(el, &bgq_pers_list, list) {
+		/* no NUL: sz may be an exact page multiple */
+		len = strlen(el->line);
+		line = text;
+		memcpy(text, el->line, len);
+		text += len;
+
+		eq = memchr(line, '=', len);
+		nl = memchr(line, '\n', len);
+		if (!eq || !nl)
+			continue;
+
+		/* drop the quotes bgq_pers_str() put around the value */
+		if (eq[1] == '"' && nl[-1] == '"' && nl - eq > 2) {
+			eq++;
+			nl--;
+		}
+
+		key->name_off = line - (char *)im;
+		key->name_len = eq - line;
+		if (*eq == '"')
+			key->name_len--;
+		key->val_off = eq + 1 - (char *)im;
+		key->val_len = nl - eq - 1;
+		key++;
+	}
+	im->nr_keys = key - (struct bgq_personality_key *)((void *)im +
+							   im->index_off);
 
-	el = list_entry(v, typeof(*el), list);
-	seq_puts(f, el->line);
+	bgq_pers_image = im;
+	bgq_pers_image_sz = sz;
+	sort((void *)im + im->index_off, im->nr_keys, sizeof(*key),
+	     bgq_pers_key_cmp, NULL);
 
 	return 0;
 }
 
-/* File/Device structure declarations */
-static const struct seq_operations bgq_persdev_seq_ops = {
-	.start = bgq_persdev_seq_start,
-	.next = bgq_persdev_seq_next,
-	.stop = bgq_persdev_seq_stop,
-	.show = bgq_persdev_seq_show
-};
+/* The text view, as it always was, copied out of the image */
+static ssize_t bgq_persdev_read(struct file *f, char __user *buf,
+				size_t count, loff_t *ppos)
+{
+	struct bgq_personality_image *im = bgq_pers_image;
+
+	return simple_read_from_buffer(buf, count, ppos,
+				       (char *)im + im->text_off,
+				       im->text_len);
+}
 
-static int bgq_persdev_open(struct inode *inode, struct file *f)
+static int bgq_persdev_mmap(struct file *f, struct vm_area_struct *vma)
 {
-	f->private_data = NULL;
-	return seq_open(f, &bgq_persdev_seq_ops);
+	unsigned long sz = vma->vm_end - vma->vm_start;
+
+	if (vma->vm_pgoff != 0 || sz > PAGE_ALIGN(bgq_pers_image_sz))
+		return -EINVAL;
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+	vma->vm_flags &= ~VM_MAYWRITE;
+
+	return remap_pfn_range(vma, vma->vm_start,
+			       virt_to_phys(bgq_pers_image) >> PAGE_SHIFT,
+			       sz, vma->vm_page_prot);
 }
 
 static const struct file_operations bgq_persdev_fops = {
 	.owner = THIS_MODULE,
-	.open = bgq_persdev_open,
-	.read = seq_read,
-	.llseek = seq_lseek,
-	.release = seq_release
+	.read = bgq_persdev_read,
+	.mmap = bgq_persdev_mmap,
+	.llseek = default_llseek,
 };
 
 static struct miscdevice bgq_persdev = {
@@ -911,17 +992,27 @@ static int __init bgq_persdev_module_init(void)
 	rc = bgq_pers_make_list(ents, local_config, &pers);
 	if (rc) {
 		pr_emerg("%s: failed to make list at %u\n", __func__, rc);
+		bgq_pers_free_list();
+		rc = -ENOMEM;
+	} else if (bgq_pers_make_image(&pers)) {
+		pr_emerg("%s: failed to make personality image\n", __func__);
+		bgq_pers_free_list();
 		rc = -ENOMEM;
 	} else {
-		/* don't need this anymore */
+		/* the image has its own copy of everything */
+		bgq_pers_free_list();
 		kfree(local_config);
 		local_config = NULL;
 
-		if (!misc_register(&bgq_persdev))
+		if (!misc_register(&bgq_persdev)) {
+			kfree(config);
 			return 0;
+		}
 
 		pr_emerg("%s: failed to register\n", __func__);
-		bgq_pers_free_list();
+		free_pages_exact(bgq_pers_image,
+				 PAGE_ALIGN(bgq_pers_image_sz));
+		bgq_pers_image = NULL;
 		rc = -ENODEV;
 	}
 	kfree(config);
@@ -935,7 +1026,7 @@ static void __exit bgq_persdev_module_exit(void)
 	printk(KERN_INFO "Releasing the Blue Gene/Q Personality Device\n");
 
 	misc_deregister(&bgq_persdev);
-	bgq_pers_free_list();
+	free_pages_exact(bgq_pers_image, PAGE_ALIGN(bgq_pers_image_sz));
 }
 
 device_initcall(bgq_persdev_module_init);
@@ -24,6 +24,7 @@
 #include <linux/fs.h>
 #include <linux/types.h>
 #include <linux/seq_file.h>
+#include <linux/proc_fs.h>
 #include <linux/uaccess.h>
 
 #include <platforms/bgq/bgq.h>
@@ -125,15 +126,19 @@ static ssize_t bgq_rasdev_write(struct file *file, const char __user *in,
 		return -EINVAL;
 	}
 
-	if (copy_from_user(&ras, in, size)) {
+	if (copy_from_user(&ras, in, sizeof(ras))) {
 		pr_emerg("%s: Failure accessing BG/Q RAS header.\n", __func__);
 		return -EFAULT;
 	}
+	if (ras.len > size - sizeof(ras)) {
+		pr_emerg("%s: RAS message truncated.\n", __func__);
+		return -EINVAL;
+	}
 	if (ras.len > 0) {
 		msg = kmalloc(ras.len, GFP_KERNEL);
 		if (!msg)
 			return -ENOMEM;
-		if (copy_from_user(msg, in, ras.len)) {
+		if (copy_from_user(msg, in + sizeof(ras), ras.len)) {
 			pr_emerg("%s: Failure accessing BG/Q RAS message.\n",
 				 __func__);
 			kfree(msg);
@@ -141,24 +146,67 @@ static ssize_t bgq_rasdev_write(struct file *file, const char __user *in,
 		}
 	}
 	if (ras.is_binary) {
-		pr_emerg("%s: Binary messages not supported yet", __func__);
-		rc = -EINVAL;
+		/* binary details are 64bit words */
+		if (ras.len % sizeof(u64)) {
+			pr_emerg("%s: RAS details not 64bit words\n",
+				 __func__);
+			rc = -EINVAL;
+		} else {
+			rc = bgq_ras_write(ras.msg_id, msg,
+					   ras.len / sizeof(u64));
+		}
 	} else {
-		if (strnlen(msg, ras.len) + 1 != ras.len) {
+		if (!msg || strnlen(msg, ras.len) + 1 != ras.len) {
 			pr_emerg("%s: RAS message not a string\n", __func__);
 			rc = -EINVAL;
 		} else {
 			rc = bgq_ras_puts(ras.msg_id, msg);
 		}
 	}
+	kfree(msg);
 	if (rc < 0)
 		return rc;
 
-	kfree(msg);
-
 	return size;
 }
 
+/*
+ * /proc/bgq_ras: how many events of each RAS id went to the control
+ * system and how many the rate limit suppressed.
+ */
+static int bgq_ras_proc_show(struct seq_file *f, void *v)
+{
+	struct bgq_ras_stat st;
+	u64 suppressed = 0;
+	unsigned slot;
+	int rc;
+
+	seq_printf(f, "%-10s %16s %16s\n", "id", "sent", "suppressed");
+	for (slot = 0; (rc = bgq_ras_stat(slot, &st)) >= 0; slot++) {
+		if (rc == 0)
+			continue;
+		seq_printf(f, "0x%08x %16llu %16llu\n",
+			   st.id, st.sent, st.suppressed);
+		suppressed += st.suppressed;
+	}
+	seq_printf(f, "total suppressed %llu\n", suppressed);
+
+	return 0;
+}
+
+static int bgq_ras_proc_open(struct inode *inode, struct file *f)
+{
+	return single_open(f, bgq_ras_proc_show, NULL);
+}
+
+static const struct file_operations bgq_ras_proc_fops = {
+	.owner = THIS_MODULE,
+	.open = bgq_ras_proc_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static const struct seq_operations bgq_rasdev_seq_ops = {
 	.start = bgq_rasdev_seq_start,
 	.next = bgq_rasdev_seq_next,
@@ -197,12 +245,16 @@ static int __init bgq_rasdev_module_init(void)
 	if ((misc_register(&bgq_rasdev)) != 0)
 		return -ENODEV;
 
+	if (!proc_create("bgq_ras", 0444, NULL, &bgq_ras_proc_fops))
+		pr_warn("%s: cannot create /proc/bgq_ras\n", __func__);
+
 	return 0;
 }
 
 static void __exit bgq_rasdev_module_exit(void)
 {
 	pr_info("Releasing the Blue Gene/Q RAS Device\n");
+	remove_proc_entry("bgq_ras", NULL);
 	misc_deregister(&bgq_rasdev);
 }
 
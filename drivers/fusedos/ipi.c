@@ -0,0 +1,117 @@
+/*
+ * FusedOS SPC interrupt fan-in
+ * authors:
+ *    Yoonho Park <yoonho@us.ibm.com>
+ *    Eric Van Hensbergen <ericvh@gmail.com>
+ *    Marius Hillenbrand <mlhillen@us.ibm.com>
+ *
+ * Licensed Materials - Property of IBM
+ *
+ * Blue Gene/Q
+ *
+ * (c) Copyright IBM Corp. 2011, 2013 All Rights Reserved
+ *
+ * US Government Users Restricted Rights - Use, duplication or
+ * disclosure restricted by GSA ADP Schedule Contract with IBM
+ * Corporation.
+ *
+ * This software is available to you under the GNU General Public
+ * License (GPL) version 2.
+ */
+
+/*
+ * SPCs signal Linux by interrupting one GPC each.  Which GPC an SPC
+ * interrupts is chosen once per SPC from the spc_ipi_cpus= list, so
+ * the interrupt load is spread over the listed GPCs instead of all
+ * landing on cpu 0.  The FusedOS module's handler is published with
+ * RCU and called without any global lock, so it must cope with
+ * running on several GPCs at once.
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/export.h>
+#include <linux/cpumask.h>
+#include <linux/rcupdate.h>
+#include <asm/cmpxchg.h>
+
+#include "fusedos.h"
+
+extern fusedos_config_t *fusedos_config;
+
+/*
+ * Still exported for modules that assign it directly.  Those get no
+ * ordering of their handler's setup and no wait for handlers still
+ * running after they clear it; new code must go through
+ * spc_ipi_register()/spc_ipi_unregister().
+ */
+void (__rcu *spc_ipi_fp)(int, uint64_t);
+EXPORT_SYMBOL(spc_ipi_fp);
+
+static struct cpumask spc_ipi_cpumask;
+static int spc_ipi_cpus_set;
+
+static int __init spc_ipi_cpus(char *str)
+{
+	if (cpulist_parse(str, &spc_ipi_cpumask) < 0 ||
+	    cpumask_empty(&spc_ipi_cpumask)) {
+		pr_warn("FUSEDOS: bad spc_ipi_cpus=%s, using cpu 0\n", str);
+		return 0;
+	}
+	spc_ipi_cpus_set = 1;
+	return 0;
+}
+early_param("spc_ipi_cpus", spc_ipi_cpus);
+
+/*
+ * The GPC that takes interrupts from SPC spc: SPCs are dealt out
+ * round-robin over the spc_ipi_cpus= list.
+ */
+int spc_ipi_cpu(int spc)
+{
+	int n;
+	int cpu;
+
+	if (!spc_ipi_cpus_set)
+		return 0;
+
+	n = spc % cpumask_weight(&spc_ipi_cpumask);
+	for_each_cpu(cpu, &spc_ipi_cpumask)
+		if (n-- == 0)
+			break;
+
+	if (cpu >= fusedos_config->nr_gpcs) {
+		pr_warn("FUSEDOS: cpu %d in spc_ipi_cpus is not a GPC\n", cpu);
+		return 0;
+	}
+	return cpu;
+}
+
+int spc_ipi_register(void (*fp)(int, uint64_t))
+{
+	/* cmpxchg() orders the handler's setup before its publication */
+	if (cmpxchg(&spc_ipi_fp, NULL, fp) != NULL)
+		return -EBUSY;
+	return 0;
+}
+EXPORT_SYMBOL(spc_ipi_register);
+
+/* On return no GPC is still running the old handler */
+void spc_ipi_unregister(void)
+{
+	rcu_assign_pointer(spc_ipi_fp, NULL);
+	synchronize_rcu();
+}
+EXPORT_SYMBOL(spc_ipi_unregister);
+
+/* Called in interrupt context on the GPC the SPCs in status signalled */
+void spc_ipi_dispatch(int cpu, uint64_t status)
+{
+	void (*fp)(int, uint64_t);
+
+	rcu_read_lock();
+	fp = rcu_dereference(spc_ipi_fp);
+	if (fp != NULL)
+		(*fp)(cpu, status);
+	rcu_read_unlock();
+}
@@ -0,0 +1,190 @@
+/*
+ * FusedOS GPC/SPC partition
+ * authors:
+ *    Yoonho Park <yoonho@us.ibm.com>
+ *    Eric Van Hensbergen <ericvh@gmail.com>
+ *    Marius Hillenbrand <mlhillen@us.ibm.com>
+ *
+ * Licensed Materials - Property of IBM
+ *
+ * Blue Gene/Q
+ *
+ * (c) Copyright IBM Corp. 2011, 2013 All Rights Reserved
+ *
+ * US Government Users Restricted Rights - Use, duplication or
+ * disclosure restricted by GSA ADP Schedule Contract with IBM
+ * Corporation.
+ *
+ * This software is available to you under the GNU General Public
+ * License (GPL) version 2.
+ */
+
+/*
+ * CPUs below nr_gpcs belong to Linux, the rest are SPCs.  nr_gpcs= sets
+ * the boot-time split; /sys/kernel/fusedos/nr_gpcs (or the FusedOS
+ * module, through fusedos_set_nr_gpcs()) moves the boundary between
+ * jobs.  The backend hands the CPUs over and rebuilds the SPC contexts,
+ * which also renumbers CPU_TO_SPC()/SPC_TO_CPU().  On BG/Q the boundary
+ * only moves up, and only until the first SPC is launched: a running
+ * monitor cannot follow its context, and a core cannot be parked back
+ * in the firmware hold loop.
+ *
+ * /sys/kernel/fusedos/spc_mem_size shrinks the memory each SPC gets
+ * and returns the rest to Linux, where the backend supports it.
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/export.h>
+#include <linux/cpumask.h>
+#include <linux/kobject.h>
+#include <linux/sysfs.h>
+#include <linux/mutex.h>
+
+#include "fusedos.h"
+
+extern fusedos_config_t *fusedos_config;
+extern spc_context_t *spc_context;
+
+static DEFINE_MUTEX(fusedos_partition_mutex);
+
+/* Only resize between jobs: no SPC may have a command outstanding */
+static int fusedos_spcs_idle(void)
+{
+	int i;
+
+	for (i = 0; i < fusedos_config->nr_spcs; i++) {
+		spc_context_t *sc = &spc_context[i];
+
+		if (sc->start || sc->cmd_ring.head != sc->cmd_ring.done)
+			return 0;
+	}
+	return 1;
+}
+
+int fusedos_set_nr_gpcs(int nr_gpcs)
+{
+	int rc = 0;
+
+	if (!fusedos_config)
+		return -ENODEV;
+	if (nr_gpcs < 1 || nr_gpcs > num_present_cpus())
+		return -EINVAL;
+
+	mutex_lock(&fusedos_partition_mutex);
+	if (nr_gpcs != fusedos_config->nr_gpcs) {
+		if (!fusedos_spcs_idle())
+			rc = -EBUSY;
+		else
+			rc = fusedos_backend_resize(nr_gpcs);
+	}
+	mutex_unlock(&fusedos_partition_mutex);
+
+	pr_info("FUSEDOS: nr_gpcs %d, nr_spcs %d (rc %d)\n",
+		fusedos_config->nr_gpcs, fusedos_config->nr_spcs, rc);
+
+	return rc;
+}
+EXPORT_SYMBOL(fusedos_set_nr_gpcs);
+
+static ssize_t nr_gpcs_show(struct kobject *kobj,
+			    struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%d\n", fusedos_config->nr_gpcs);
+}
+
+static ssize_t nr_gpcs_store(struct kobject *kobj,
+			     struct kobj_attribute *attr,
+			     const char *buf, size_t count)
+{
+	unsigned long val;
+	int err;
+
+	err = strict_strtoul(buf, 10, &val);
+	if (err || val > INT_MAX)
+		return -EINVAL;
+
+	err = fusedos_set_nr_gpcs(val);
+	if (err)
+		return err;
+
+	return count;
+}
+static struct kobj_attribute nr_gpcs_attr =
+	__ATTR(nr_gpcs, 0644, nr_gpcs_show, nr_gpcs_store);
+
+static ssize_t nr_spcs_show(struct kobject *kobj,
+			    struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%d\n", fusedos_config->nr_spcs);
+}
+static struct kobj_attribute nr_spcs_attr = __ATTR_RO(nr_spcs);
+
+static ssize_t spc_mem_size_show(struct kobject *kobj,
+				 struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%llu\n", fusedos_config->spc_mem_size);
+}
+
+static ssize_t spc_mem_size_store(struct kobject *kobj,
+				  struct kobj_attribute *attr,
+				  const char *buf, size_t count)
+{
+	unsigned long long size;
+	char *end;
+	int err;
+
+	size = memparse(buf, &end);
+	if (end == buf)
+		return -EINVAL;
+
+	mutex_lock(&fusedos_partition_mutex);
+	if (!fusedos_spcs_idle())
+		err = -EBUSY;
+	else
+		err = fusedos_backend_set_spc_mem(size);
+	mutex_unlock(&fusedos_partition_mutex);
+	if (err)
+		return err;
+
+	return count;
+}
+static struct kobj_attribute spc_mem_size_attr =
+	__ATTR(spc_mem_size, 0644, spc_mem_size_show, spc_mem_size_store);
+
+static struct attribute *fusedos_attrs[] = {
+	&nr_gpcs_attr.attr,
+	&nr_spcs_attr.attr,
+	&spc_mem_size_attr.attr,
+	NULL,
+};
+
+static struct attribute_group fusedos_attr_group = {
+	.attrs = fusedos_attrs,
+};
+
+static int __init fusedos_partition_init(void)
+{
+	struct kobject *kobj;
+	int err;
+
+	if (!fusedos_config)
+		return 0;
+
+	kobj = kobject_create_and_add("fusedos", kernel_kobj);
+	if (!kobj)
+		return -ENOMEM;
+
+	err = sysfs_create_group(kobj, &fusedos_attr_group);
+	if (err) {
+		pr_err("FUSEDOS: cannot register sysfs attributes\n");
+		kobject_put(kobj);
+		return err;
+	}
+
+	err = fusedos_tlb_sysfs_init(kobj);
+	if (err)
+		pr_err("FUSEDOS: cannot register SPC TLB statistics\n");
+	return err;
+}
+late_initcall(fusedos_partition_init);
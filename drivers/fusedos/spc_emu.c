@@ -0,0 +1,454 @@
+/*
+ * FusedOS SPC emulator
+ * authors:
+ *    Yoonho Park <yoonho@us.ibm.com>
+ *    Eric Van Hensbergen <ericvh@gmail.com>
+ *    Marius Hillenbrand <mlhillen@us.ibm.com>
+ *
+ * Licensed Materials - Property of IBM
+ *
+ * Blue Gene/Q
+ *
+ * (c) Copyright IBM Corp. 2011, 2013 All Rights Reserved
+ *
+ * US Government Users Restricted Rights - Use, duplication or
+ * disclosure restricted by GSA ADP Schedule Contract with IBM
+ * Corporation.
+ *
+ * This software is available to you under the GNU General Public
+ * License (GPL) version 2.
+ */
+
+/*
+ * Emulates single-purpose cores on an ordinary SMP machine so that the
+ * FusedOS command protocol can be exercised without Blue Gene/Q
+ * hardware.  Every CPU at or above nr_gpcs runs one kthread that polls
+ * its spc_context_t like the SPC monitor does: it waits for start,
+ * executes command, clears start and then signals the GPC stored in
+ * bic_value.  The signal is a cross-CPU call that ends up in spc_ipi_fp
+ * with the same status word encoding bgq_ipi_dispatch() produces.
+ *
+ * Commands posted to cmd_ring are drained in one go whenever the
+ * doorbell is set, followed by a single signal for the whole batch.
+ *
+ * The emulator does not run SPC application code.  SPC_START and
+ * SPC_RESUME spin for run_ns nanoseconds and then complete, which is
+ * enough to measure command round trips and interrupt fan-in.
+ */
+
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/init.h>
+#include <linux/kthread.h>
+#include <linux/sched.h>
+#include <linux/smp.h>
+#include <linux/cpumask.h>
+#include <linux/percpu.h>
+#include <linux/bitops.h>
+#include <linux/gfp.h>
+#include <linux/slab.h>
+#include <linux/wait.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+
+#include "fusedos_config.h"
+#include "fusedos.h"
+
+#define SPC_EMU_NR_CMDS (SPC_UPCP_INIT + 1)
+
+struct spc_emu {
+	struct task_struct *thread;
+	struct call_single_data csd;
+	int spc;
+	u64 nr_cmds[SPC_EMU_NR_CMDS];
+	u64 nr_unknown;
+	u64 nr_ipis;
+	u64 nr_quits;
+	u64 nr_ring_cmds;
+	u64 nr_ring_batches;
+};
+
+static int NR_GPCS = -1;
+void *spc_monitor;
+EXPORT_SYMBOL(spc_monitor);
+spc_context_t *spc_context;
+EXPORT_SYMBOL(spc_context);
+fusedos_config_t *fusedos_config;
+EXPORT_SYMBOL(fusedos_config);
+
+/* there is no BG/Q firmware underneath the emulator */
+void *_fw;
+EXPORT_SYMBOL(_fw);
+
+wait_queue_head_t cl_wait_array[NR_CPUS];
+wait_queue_head_t *cl_wait = cl_wait_array;
+EXPORT_SYMBOL(cl_wait);
+
+static struct spc_emu *spc_emu;
+static int spc_emu_max_spcs;
+static DEFINE_PER_CPU(unsigned long, spc_emu_pending);
+
+static ulong run_ns;
+module_param(run_ns, ulong, 0644);
+MODULE_PARM_DESC(run_ns, "Time an emulated SPC_START/SPC_RESUME runs (ns)");
+
+static const char * const spc_emu_cmd_name[SPC_EMU_NR_CMDS] = {
+	[SPC_START] = "start",
+	[SPC_RESUME] = "resume",
+	[SPC_LOAD_TLB] = "load_tlb",
+	[SPC_UNLOAD_TLB] = "unload_tlb",
+	[SPC_EXIT] = "exit",
+	[SPC_SAVE_FPU] = "save_fpu",
+	[SPC_UPC_INIT] = "upc_init",
+	[SPC_UPCP_INIT] = "upcp_init",
+};
+
+static int __init nr_gpcs(char *str)
+{
+	int val;
+
+	if (get_option(&str, &val) && val > 0)
+		NR_GPCS = val;
+	return 0;
+}
+early_param("nr_gpcs", nr_gpcs);
+
+/* Runs on the GPC, stands in for the C2C part of bgq_ipi_dispatch() */
+static void spc_emu_ipi(void *info)
+{
+	int cpu = smp_processor_id();
+	unsigned long pending;
+	u64 status = 0;
+	int spc;
+
+	pending = xchg(&per_cpu(spc_emu_pending, cpu), 0);
+	for_each_set_bit(spc, &pending, BITS_PER_LONG)
+		status |= SPC_C2C_BIT(spc);
+	if (!status)
+		return;
+
+	spc_ipi_dispatch(cpu, status);
+}
+
+/* The emulated equivalent of the SPC storing bic_value to bic_int_send */
+static void spc_emu_signal(struct spc_emu *se, spc_context_t *sc)
+{
+	int gpc = sc->bic_value;
+
+	set_bit(se->spc, &per_cpu(spc_emu_pending, gpc));
+	se->nr_ipis++;
+	__smp_call_function_single(gpc, &se->csd, 0);
+}
+
+static void spc_emu_run(void)
+{
+	u64 end;
+
+	if (!run_ns)
+		return;
+	end = local_clock() + run_ns;
+	while (local_clock() < end)
+		cpu_relax();
+}
+
+/*
+ * Emulated install: count the entries a real SPC would write.  The
+ * writer marks tlb_dirty[gen & 1], so only the other half is ours to
+ * read and clear; bits left over there from a skipped generation only
+ * cost a redundant install later.
+ */
+static void spc_emu_load_tlb(spc_context_t *sc)
+{
+	spc_tlb_stats_t *st = &sc->tlb_stats;
+	uint64_t gen = sc->tlb_gen;
+	uint64_t *dirty = sc->tlb_dirty[(gen - 1) & 1];
+	int w;
+
+	if (sc->tlb_installed_gen && sc->tlb_installed_gen == gen) {
+		st->skipped_loads++;
+		return;
+	}
+	smp_rmb();
+	if (!sc->tlb_installed_gen || sc->tlb_installed_gen + 1 != gen) {
+		st->installs += sc->tlb_entry_count;
+		st->full_loads++;
+	} else {
+		for (w = 0; w < MAX_TLB_ENTRIES / 64; w++)
+			st->installs += hweight64(dirty[w]);
+		st->delta_loads++;
+	}
+	memset(dirty, 0, sizeof(sc->tlb_dirty[0]));
+	sc->tlb_entry_install = sc->tlb_entry_count;
+	smp_mb();
+	/*
+	 * A writer that committed meanwhile may already be marking the
+	 * half we just cleared: force a full load next time.
+	 */
+	sc->tlb_installed_gen = sc->tlb_gen != gen ? 0 : gen;
+}
+
+static void spc_emu_exec(struct spc_emu *se, spc_context_t *sc, uint64_t cmd)
+{
+	switch (cmd) {
+	case SPC_START:
+	case SPC_RESUME:
+		spc_emu_run();
+		break;
+	case SPC_LOAD_TLB:
+		spc_emu_load_tlb(sc);
+		break;
+	case SPC_UNLOAD_TLB:
+		sc->tlb_installed_gen = 0;
+		sc->tlb_entry_install = 0;
+		break;
+	case SPC_EXIT:
+	case SPC_SAVE_FPU:
+	case SPC_UPC_INIT:
+	case SPC_UPCP_INIT:
+		break;
+	default:
+		se->nr_unknown++;
+		return;
+	}
+	se->nr_cmds[cmd]++;
+}
+
+static void spc_emu_command(struct spc_emu *se, spc_context_t *sc)
+{
+	spc_emu_exec(se, sc, sc->command);
+	sc->ex_code = 0;
+	/* results must be visible before the CL sees start drop */
+	smp_wmb();
+	sc->start = 0;
+	spc_emu_signal(se, sc);
+}
+
+/* Drain everything posted before the doorbell, then signal once */
+static void spc_emu_ring(struct spc_emu *se, spc_context_t *sc)
+{
+	spc_ring_t *r = &sc->cmd_ring;
+	spc_ring_desc_t d;
+	int n = 0;
+
+	r->doorbell = 0;
+	smp_mb();
+	while (spc_ring_take(r, &d)) {
+		spc_emu_exec(se, sc, d.cmd);
+		smp_wmb();
+		r->done++;
+		n++;
+	}
+	if (!n)
+		return;
+	se->nr_ring_cmds += n;
+	se->nr_ring_batches++;
+	spc_emu_signal(se, sc);
+}
+
+static void spc_emu_ipi_message(struct spc_emu *se, spc_context_t *sc)
+{
+	if (sc->ipi_message.fcn == SPC_IPI_QUIT) {
+		se->nr_quits++;
+		sc->start = 0;
+	}
+	sc->ipi_message.fcn = 0;
+	smp_wmb();
+	spc_emu_signal(se, sc);
+}
+
+static int spc_emu_thread(void *arg)
+{
+	struct spc_emu *se = arg;
+	spc_context_t *sc = &spc_context[se->spc];
+
+	while (!kthread_should_stop()) {
+		if (sc->ipi_message.fcn)
+			spc_emu_ipi_message(se, sc);
+
+		if (sc->cmd_ring.doorbell)
+			spc_emu_ring(se, sc);
+
+		if (sc->start) {
+			/* read the command only after start was seen */
+			smp_rmb();
+			spc_emu_command(se, sc);
+			continue;
+		}
+		cpu_relax();
+		cond_resched();
+	}
+
+	return 0;
+}
+
+static void spc_emu_context_init(void)
+{
+	int i;
+
+	for (i = 0; i < fusedos_config->nr_spcs; i++) {
+		spc_context[i].abi_version = SPC_CONTEXT_ABI_VERSION;
+		spc_context[i].abi_size = sizeof(spc_context_t);
+		spc_context[i].bic_int_send = NULL;
+		spc_context[i].bic_value = spc_ipi_cpu(i);
+		spc_context[i].id = i;
+		spc_ring_init(&spc_context[i].cmd_ring);
+	}
+}
+
+static int spc_emu_stats_show(struct seq_file *m, void *v)
+{
+	int i;
+	int c;
+
+	seq_printf(m, "%-4s %-4s %-4s", "spc", "cpu", "gpc");
+	for (c = 0; c < SPC_EMU_NR_CMDS; c++)
+		if (spc_emu_cmd_name[c])
+			seq_printf(m, " %10s", spc_emu_cmd_name[c]);
+	seq_printf(m, " %10s %10s %10s %10s %10s\n", "unknown", "quit",
+		   "ring", "batches", "ipis");
+
+	for (i = 0; i < fusedos_config->nr_spcs; i++) {
+		struct spc_emu *se = &spc_emu[i];
+
+		seq_printf(m, "%-4d %-4d %-4llu", i, SPC_TO_CPU(i),
+			   spc_context[i].bic_value);
+		for (c = 0; c < SPC_EMU_NR_CMDS; c++)
+			if (spc_emu_cmd_name[c])
+				seq_printf(m, " %10llu", se->nr_cmds[c]);
+		seq_printf(m, " %10llu %10llu %10llu %10llu %10llu\n",
+			   se->nr_unknown, se->nr_quits, se->nr_ring_cmds,
+			   se->nr_ring_batches, se->nr_ipis);
+	}
+	return 0;
+}
+
+static int spc_emu_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, spc_emu_stats_show, NULL);
+}
+
+static const struct file_operations spc_emu_stats_fops = {
+	.open = spc_emu_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void spc_emu_start(int i)
+{
+	struct spc_emu *se = &spc_emu[i];
+	int cpu = SPC_TO_CPU(i);
+
+	if (!cpu_online(cpu)) {
+		pr_warn("FUSEDOS spc_emu: cpu %d for SPC %d is offline\n",
+			cpu, i);
+		return;
+	}
+	se->thread = kthread_create_on_node(spc_emu_thread, se,
+					    cpu_to_node(cpu), "spc_emu/%d", i);
+	if (IS_ERR(se->thread)) {
+		pr_err("FUSEDOS spc_emu: cannot start SPC %d\n", i);
+		se->thread = NULL;
+		return;
+	}
+	kthread_bind(se->thread, cpu);
+	wake_up_process(se->thread);
+}
+
+static void spc_emu_stop(int i)
+{
+	struct spc_emu *se = &spc_emu[i];
+
+	if (!se->thread)
+		return;
+	kthread_stop(se->thread);
+	se->thread = NULL;
+}
+
+/*
+ * Emulated SPCs are online Linux CPUs running a kthread, so handing a
+ * CPU back to Linux just means stopping its kthread.
+ */
+int fusedos_backend_resize(int nr_gpcs)
+{
+	int i;
+
+	for (i = 0; i < fusedos_config->nr_spcs; i++)
+		spc_emu_stop(i);
+
+	NR_GPCS = nr_gpcs;
+	fusedos_config->nr_gpcs = nr_gpcs;
+	fusedos_config->nr_spcs = min_t(int, num_present_cpus() - nr_gpcs,
+					spc_emu_max_spcs);
+	memset(spc_context, 0, SPC_CONTEXT_SIZE);
+	spc_emu_context_init();
+
+	for (i = 0; i < fusedos_config->nr_spcs; i++)
+		spc_emu_start(i);
+
+	return 0;
+}
+
+/* emulated SPCs run no application code and own no memory */
+int fusedos_backend_set_spc_mem(unsigned long size)
+{
+	return -EOPNOTSUPP;
+}
+
+static int __init spc_emu_init(void)
+{
+	void *area;
+	int i;
+
+	if (NR_GPCS < 0 || NR_GPCS > num_present_cpus())
+		NR_GPCS = num_present_cpus();
+
+	/* keep the layout the CL expects: the config block follows
+	 * the context area */
+	area = alloc_pages_exact(SPC_CONTEXT_SIZE + FUSEDOS_CONFIG_SIZE,
+				 GFP_KERNEL | __GFP_ZERO);
+	if (!area) {
+		pr_err("FUSEDOS spc_emu: cannot allocate SPC context area\n");
+		return -ENOMEM;
+	}
+	spc_context = area;
+	fusedos_config = area + SPC_CONTEXT_SIZE;
+
+	fusedos_config->nr_gpcs = NR_GPCS;
+	fusedos_config->nr_spcs = num_present_cpus() - NR_GPCS;
+	fusedos_config->fusedos_debug = 0;
+
+	spc_emu_max_spcs = min_t(int, num_present_cpus() - 1,
+				 min_t(int, SPC_CONTEXT_SIZE / sizeof(spc_context_t),
+				       BITS_PER_LONG));
+	if (fusedos_config->nr_spcs > spc_emu_max_spcs) {
+		pr_warn("FUSEDOS spc_emu: limiting to %d SPCs\n",
+			spc_emu_max_spcs);
+		fusedos_config->nr_spcs = spc_emu_max_spcs;
+	}
+
+	pr_info("FUSEDOS spc_emu: NR_GPCS %d, num_present_cpus %d, nr_spcs %d\n",
+		NR_GPCS, num_present_cpus(), fusedos_config->nr_spcs);
+
+	spc_emu_context_init();
+
+	spc_emu = kcalloc(spc_emu_max_spcs, sizeof(*spc_emu), GFP_KERNEL);
+	if (!spc_emu)
+		return -ENOMEM;
+
+	for (i = 0; i < spc_emu_max_spcs; i++) {
+		spc_emu[i].spc = i;
+		spc_emu[i].csd.func = spc_emu_ipi;
+		spc_emu[i].csd.info = &spc_emu[i];
+	}
+
+	for (i = 0; i < fusedos_config->nr_spcs; i++)
+		spc_emu_start(i);
+
+	debugfs_create_file("stats", 0444,
+			    debugfs_create_dir("fusedos_spc_emu", NULL),
+			    NULL, &spc_emu_stats_fops);
+
+	return 0;
+}
+device_initcall(spc_emu_init);
@@ -0,0 +1,108 @@
+/*
+ * FusedOS SPC TLB statistics
+ * authors:
+ *    Yoonho Park <yoonho@us.ibm.com>
+ *    Eric Van Hensbergen <ericvh@gmail.com>
+ *    Marius Hillenbrand <mlhillen@us.ibm.com>
+ *
+ * Licensed Materials - Property of IBM
+ *
+ * Blue Gene/Q
+ *
+ * (c) Copyright IBM Corp. 2011, 2013 All Rights Reserved
+ *
+ * US Government Users Restricted Rights - Use, duplication or
+ * disclosure restricted by GSA ADP Schedule Contract with IBM
+ * Corporation.
+ *
+ * This software is available to you under the GNU General Public
+ * License (GPL) version 2.
+ */
+
+/*
+ * The SPCs count TLB installs, misses and the kind of each SPC_LOAD_TLB
+ * in spc_context_t.tlb_stats.  Export them as
+ * /sys/kernel/fusedos/spc<N>/tlb/<counter>.
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/cpumask.h>
+#include <linux/kobject.h>
+#include <linux/sysfs.h>
+
+#include "fusedos_config.h"
+#include "fusedos.h"
+
+extern spc_context_t *spc_context;
+
+static struct kobject *spc_kobj[BITS_PER_LONG];
+static int spc_kobj_count;
+
+static spc_tlb_stats_t *spc_kobj_tlb_stats(struct kobject *kobj)
+{
+	int i;
+
+	for (i = 0; i < spc_kobj_count; i++)
+		if (spc_kobj[i] == kobj)
+			return &spc_context[i].tlb_stats;
+	return NULL;
+}
+
+#define SPC_TLB_ATTR(_name)						\
+static ssize_t _name##_show(struct kobject *kobj,			\
+			    struct kobj_attribute *attr, char *buf)	\
+{									\
+	spc_tlb_stats_t *st = spc_kobj_tlb_stats(kobj);			\
+									\
+	if (!st)							\
+		return -ENODEV;						\
+	return sprintf(buf, "%llu\n", st->_name);			\
+}									\
+static struct kobj_attribute _name##_attr = __ATTR_RO(_name)
+
+SPC_TLB_ATTR(installs);
+SPC_TLB_ATTR(misses);
+SPC_TLB_ATTR(full_loads);
+SPC_TLB_ATTR(delta_loads);
+SPC_TLB_ATTR(skipped_loads);
+
+static struct attribute *spc_tlb_attrs[] = {
+	&installs_attr.attr,
+	&misses_attr.attr,
+	&full_loads_attr.attr,
+	&delta_loads_attr.attr,
+	&skipped_loads_attr.attr,
+	NULL,
+};
+
+static struct attribute_group spc_tlb_attr_group = {
+	.name = "tlb",
+	.attrs = spc_tlb_attrs,
+};
+
+/* One directory for every CPU that can become an SPC */
+int __init fusedos_tlb_sysfs_init(struct kobject *parent)
+{
+	char name[16];
+	int nr;
+	int i;
+	int err;
+
+	nr = min_t(int, num_present_cpus(),
+		   min_t(int, SPC_CONTEXT_SIZE / sizeof(spc_context_t),
+			 BITS_PER_LONG));
+
+	for (i = 0; i < nr; i++) {
+		snprintf(name, sizeof(name), "spc%d", i);
+		spc_kobj[i] = kobject_create_and_add(name, parent);
+		if (!spc_kobj[i])
+			return -ENOMEM;
+		spc_kobj_count = i + 1;
+
+		err = sysfs_create_group(spc_kobj[i], &spc_tlb_attr_group);
+		if (err)
+			return err;
+	}
+	return 0;
+}
@@ -148,6 +148,8 @@ static inline unsigned int cpumask_any_but(const struct cpumask *mask,
 	for ((cpu) = 0; (cpu) < 1; (cpu)++, (void)mask)
 #define for_each_cpu_and(cpu, mask, and)	\
 	for ((cpu) = 0; (cpu) < 1; (cpu)++, (void)mask, (void)and)
+#define for_each_cpu_wrap(cpu, mask, start)	\
+	for ((cpu) = 0; (cpu) < 1; (cpu)++, (void)mask, (void)(start))
 #else
 /**
  * cpumask_first - get the first cpu in a cpumask
@@ -192,6 +194,7 @@ static inline unsigned int cpumask_next_zero(int n, const struct cpumask *srcp)
 
 int cpumask_next_and(int n, const struct cpumask *, const struct cpumask *);
 int cpumask_any_but(const struct cpumask *mask, unsigned int cpu);
+int cpumask_next_wrap(int n, const struct cpumask *mask, int start, bool wrap);
 
 /**
  * for_each_cpu - iterate over every cpu in a mask
@@ -235,6 +238,19 @@ int cpumask_any_but(const struct cpumask *mask, unsigned int cpu);
 	for ((cpu) = -1;						\
 		(cpu) = cpumask_next_and((cpu), (mask), (and)),		\
 		(cpu) < nr_cpu_ids;)
+
+/**
+ * for_each_cpu_wrap - iterate over every cpu in a mask, starting at @start
+ * @cpu: the (optionally unsigned) integer iterator
+ * @mask: the cpumask pointer
+ * @start: the cpu to start from; the iteration wraps around past the end
+ *
+ * After the loop, cpu is >= nr_cpu_ids.
+ */
+#define for_each_cpu_wrap(cpu, mask, start)					\
+	for ((cpu) = cpumask_next_wrap((start) - 1, (mask), (start), false);	\
+	     (cpu) < nr_cpu_ids;						\
+	     (cpu) = cpumask_next_wrap((cpu), (mask), (start), true))
 #endif /* SMP */
 
 #define CPU_BITS_NONE						\
@@ -11,6 +11,11 @@ extern int copy_huge_pmd(struct mm_struct *dst_mm, struct mm_struct *src_mm,
 extern int do_huge_pmd_wp_page(struct mm_struct *mm, struct vm_area_struct *vma,
 			       unsigned long address, pmd_t *pmd,
 			       pmd_t orig_pmd);
+extern int do_huge_pmd_file_page(struct mm_struct *mm,
+				 struct vm_area_struct *vma,
+				 unsigned long address, pmd_t *pmd,
+				 struct address_space *mapping, pgoff_t pgoff,
+				 unsigned int flags);
 extern pgtable_t get_pmd_huge_pte(struct mm_struct *mm);
 extern struct page *follow_trans_huge_pmd(struct mm_struct *mm,
 					  unsigned long addr,
@@ -90,13 +95,22 @@ extern int handle_pte_fault(struct mm_struct *mm,
 			    struct vm_area_struct *vma, unsigned long address,
 			    pte_t *pte, pmd_t *pmd, unsigned int flags);
 extern int split_huge_page(struct page *page);
-extern void __split_huge_page_pmd(struct mm_struct *mm, pmd_t *pmd);
-#define split_huge_page_pmd(__mm, __pmd)				\
+extern void __split_huge_page_pmd(struct vm_area_struct *vma,
+				  unsigned long address, pmd_t *pmd);
+#define split_huge_page_pmd(__vma, __address, __pmd)			\
 	do {								\
 		pmd_t *____pmd = (__pmd);				\
 		if (unlikely(pmd_trans_huge(*____pmd)))			\
-			__split_huge_page_pmd(__mm, ____pmd);		\
+			__split_huge_page_pmd(__vma, __address,		\
+					      ____pmd);			\
 	}  while (0)
+extern void split_huge_page_pmd_mm(struct mm_struct *mm, unsigned long address,
+				   pmd_t *pmd);
+extern void split_huge_page_address(struct vm_area_struct *vma,
+				    unsigned long address);
+extern pmd_t *page_check_address_file_pmd(struct page *page,
+					  struct mm_struct *mm,
+					  unsigned long address);
 #define wait_split_huge_page(__anon_vma, __pmd)				\
 	do {								\
 		pmd_t *____pmd = (__pmd);				\
@@ -131,7 +145,7 @@ static inline void vma_adjust_trans_huge(struct vm_area_struct *vma,
 					 unsigned long end,
 					 long adjust_next)
 {
-	if (!vma->anon_vma || vma->vm_ops)
+	if (vma->vm_ops ? !vma->vm_ops->pmd_fault : !vma->anon_vma)
 		return;
 	__vma_adjust_trans_huge(vma, start, end, adjust_next);
 }
@@ -172,8 +186,20 @@ static inline int split_huge_page(struct page *page)
 {
 	return 0;
 }
-#define split_huge_page_pmd(__mm, __pmd)	\
+#define split_huge_page_pmd(__vma, __address, __pmd)	\
 	do { } while (0)
+#define split_huge_page_pmd_mm(__mm, __address, __pmd)	\
+	do { } while (0)
+static inline void split_huge_page_address(struct vm_area_struct *vma,
+					   unsigned long address)
+{
+}
+static inline pmd_t *page_check_address_file_pmd(struct page *page,
+						 struct mm_struct *mm,
+						 unsigned long address)
+{
+	return NULL;
+}
 #define wait_split_huge_page(__anon_vma, __pmd)	\
 	do { } while (0)
 #define compound_trans_head(page) compound_head(page)
@@ -195,6 +195,10 @@ struct vm_fault {
 					 * is set (which is also implied by
 					 * VM_FAULT_ERROR).
 					 */
+	/* for ->map_pages() only */
+	pgoff_t max_pgoff;		/* map pages for offset from pgoff till
+					 * max_pgoff inclusive */
+	pte_t *pte;			/* pte entry associated with ->pgoff */
 };
 
 /*
@@ -207,6 +211,22 @@ struct vm_operations_struct {
 	void (*close)(struct vm_area_struct * area);
 	int (*fault)(struct vm_area_struct *vma, struct vm_fault *vmf);
 
+	/*
+	 * Called under the page table lock of a read fault, before ->fault,
+	 * to map whatever pages from vmf->pgoff to vmf->max_pgoff are already
+	 * uptodate in the page cache; must not sleep, and must skip any pte
+	 * which is not none.
+	 */
+	void (*map_pages)(struct vm_area_struct *vma, struct vm_fault *vmf);
+
+	/*
+	 * Called for a fault on an empty pmd covering a hugepage aligned
+	 * range of the vma: may map a huge page there, or return
+	 * VM_FAULT_FALLBACK to have the fault handled by ->fault instead.
+	 */
+	int (*pmd_fault)(struct vm_area_struct *vma, unsigned long address,
+			 pmd_t *pmd, unsigned int flags);
+
 	/* notification that a previously read-only page is about to become
 	 * writable, if an error is returned it will cause a SIGBUS */
 	int (*page_mkwrite)(struct vm_area_struct *vma, struct vm_fault *vmf);
@@ -845,6 +865,7 @@ static inline int page_mapped(struct page *page)
 #define VM_FAULT_NOPAGE	0x0100	/* ->fault installed the pte, not return page */
 #define VM_FAULT_LOCKED	0x0200	/* ->fault locked the returned page */
 #define VM_FAULT_RETRY	0x0400	/* ->fault blocked, must retry */
+#define VM_FAULT_FALLBACK 0x0800	/* ->pmd_fault could not map a huge page */
 
 #define VM_FAULT_HWPOISON_LARGE_MASK 0xf000 /* encodes hpage index for large hwpoison */
 
@@ -965,6 +986,8 @@ extern int handle_mm_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 			unsigned long address, unsigned int flags);
 extern int fixup_user_fault(struct task_struct *tsk, struct mm_struct *mm,
 			    unsigned long address, unsigned int fault_flags);
+extern void do_set_pte(struct vm_area_struct *vma, unsigned long address,
+		       struct page *page, pte_t *pte, bool write, bool anon);
 #else
 static inline int handle_mm_fault(struct mm_struct *mm,
 			struct vm_area_struct *vma, unsigned long address,
@@ -1410,11 +1433,13 @@ extern unsigned long vm_mmap(struct file *, unsigned long,
 
 /* truncate.c */
 extern void truncate_inode_pages(struct address_space *, loff_t);
+extern void clear_shadow_entries(struct address_space *, pgoff_t, pgoff_t);
 extern void truncate_inode_pages_range(struct address_space *,
 				       loff_t lstart, loff_t lend);
 
 /* generic vm_area_ops exported for stackable file systems */
 extern int filemap_fault(struct vm_area_struct *, struct vm_fault *);
+extern void filemap_map_pages(struct vm_area_struct *vma, struct vm_fault *vmf);
 
 /* mm/page-writeback.c */
 int write_one_page(struct page *page, int wait);
@@ -1499,6 +1524,34 @@ static inline pgprot_t vm_get_page_prot(unsigned long vm_flags)
 }
 #endif
 
+#ifdef CONFIG_NUMA_BALANCING
+/* PROT_NONE for @vma, used for NUMA hinting faults */
+static inline pgprot_t vma_prot_none(struct vm_area_struct *vma)
+{
+	return vm_get_page_prot(vma->vm_flags & ~(VM_READ|VM_WRITE|VM_EXEC));
+}
+
+/*
+ * A pte that has PROT_NONE protection in a vma that is not PROT_NONE
+ * is a NUMA hinting pte: it was set by change_prot_numa() and the
+ * fault only restores vma->vm_page_prot.
+ */
+static inline bool pte_numa(struct vm_area_struct *vma, pte_t pte)
+{
+	if (pte_same(pte, pte_modify(pte, vma->vm_page_prot)))
+		return false;
+	return pte_same(pte, pte_modify(pte, vma_prot_none(vma)));
+}
+
+extern unsigned long change_prot_numa(struct vm_area_struct *vma,
+			unsigned long start, unsigned long end);
+#else
+static inline bool pte_numa(struct vm_area_struct *vma, pte_t pte)
+{
+	return false;
+}
+#endif
+
 struct vm_area_struct *find_extend_vma(struct mm_struct *, unsigned long addr);
 int remap_pfn_range(struct vm_area_struct *, unsigned long addr,
 			unsigned long pfn, unsigned long size, pgprot_t);
@@ -398,6 +398,13 @@ struct mm_struct {
 #ifdef CONFIG_CPUMASK_OFFSTACK
 	struct cpumask cpumask_allocation;
 #endif
+#ifdef CONFIG_NUMA_BALANCING
+	/* jiffies after which the next NUMA hinting scan may start */
+	unsigned long numa_next_scan;
+	/* where the next scan continues, and how often it wrapped */
+	unsigned long numa_scan_offset;
+	int numa_scan_seq;
+#endif
 };
 
 static inline void mm_init_cpumask(struct mm_struct *mm)
@@ -170,6 +170,7 @@ enum ttu_flags {
 	TTU_IGNORE_MLOCK = (1 << 8),	/* ignore mlock */
 	TTU_IGNORE_ACCESS = (1 << 9),	/* don't age */
 	TTU_IGNORE_HWPOISON = (1 << 10),/* corrupted page is recoverable */
+	TTU_LZFREE = (1 << 11),		/* drop clean anon pages (MADV_FREE) */
 };
 #define TTU_ACTION(x) ((x) & TTU_ACTION_MASK)
 
@@ -31,6 +31,7 @@ struct shmem_sb_info {
 	uid_t uid;		    /* Mount uid for root directory */
 	gid_t gid;		    /* Mount gid for root directory */
 	umode_t mode;		    /* Mount mode for root directory */
+	unsigned char huge;	    /* Whether to try for hugepages */
 	struct mempolicy *mpol;     /* default memory policy for mappings */
 };
 
@@ -53,6 +54,13 @@ extern struct page *shmem_read_mapping_page_gfp(struct address_space *mapping,
 					pgoff_t index, gfp_t gfp_mask);
 extern void shmem_truncate_range(struct inode *inode, loff_t start, loff_t end);
 extern int shmem_unuse(swp_entry_t entry, struct page *page);
+extern bool shmem_mapping(struct address_space *mapping);
+
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+/* /sys/kernel/mm/transparent_hugepage/shmem_enabled */
+struct kobj_attribute;
+extern struct kobj_attribute shmem_enabled_attr;
+#endif
 
 static inline struct page *shmem_read_mapping_page(
 				struct address_space *mapping, pgoff_t index)
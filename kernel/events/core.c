@@ -2563,6 +2563,15 @@ void perf_event_task_tick(void)
 	}
 }
 
+/*
+ * perf_event_task_tick() rotates and unthrottles the contexts on the
+ * rotation list; a full dynticks cpu must keep its tick while any are.
+ */
+bool perf_event_can_stop_tick(void)
+{
+	return list_empty(&__get_cpu_var(rotation_list));
+}
+
 static int event_enable_on_exec(struct perf_event *event,
 				struct perf_event_context *ctx)
 {
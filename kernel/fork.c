@@ -198,6 +198,7 @@ void __put_task_struct(struct task_struct *tsk)
 	exit_creds(tsk);
 	delayacct_tsk_free(tsk);
 	put_signal_struct(tsk->signal);
+	task_numa_free(tsk);
 
 	if (!profile_handoff_task(tsk))
 		free_task(tsk);
@@ -503,6 +504,12 @@ static struct mm_struct *mm_init(struct mm_struct *mm, struct task_struct *p)
 	mm->cached_hole_size = ~0UL;
 	mm_init_aio(mm);
 	mm_init_owner(mm, p);
+#ifdef CONFIG_NUMA_BALANCING
+	mm->numa_next_scan = jiffies +
+		msecs_to_jiffies(sysctl_numa_balancing_scan_delay);
+	mm->numa_scan_offset = 0;
+	mm->numa_scan_seq = 0;
+#endif
 
 	if (likely(!mm_alloc_pgd(mm))) {
 		mm->def_flags = 0;
@@ -8,6 +8,7 @@
 #include <linux/math64.h>
 #include <asm/uaccess.h>
 #include <linux/kernel_stat.h>
+#include <linux/tick.h>
 #include <trace/events/timer.h>
 
 /*
@@ -580,6 +581,9 @@ static void arm_timer(struct k_itimer *timer)
 				cputime_expires->sched_exp = exp->sched;
 			break;
 		}
+
+		/* The task may be running on a cpu with the tick off */
+		tick_nohz_full_kick_all();
 	}
 }
 
@@ -1234,6 +1238,21 @@ static inline int task_cputime_expired(const struct task_cputime *sample,
 	return 0;
 }
 
+/*
+ * Cpu timers are only checked from the tick: a full dynticks cpu keeps
+ * it while the task, or its thread group, has one armed.
+ */
+bool posix_cpu_timers_can_stop_tick(struct task_struct *tsk)
+{
+	if (!task_cputime_zero(&tsk->cputime_expires))
+		return false;
+
+	if (tsk->signal->cputimer.running)
+		return false;
+
+	return true;
+}
+
 /**
  * fastpath_timer_check - POSIX CPU timers fast path.
  *
@@ -1389,6 +1408,8 @@ void set_process_cpu_timer(struct task_struct *tsk, unsigned int clock_idx,
 			tsk->signal->cputime_expires.virt_exp = *newval;
 		break;
 	}
+
+	tick_nohz_full_kick_all();
 }
 
 static int do_cpu_nanosleep(const clockid_t which_clock, int flags,
@@ -52,6 +52,7 @@
 #include <linux/prefetch.h>
 #include <linux/delay.h>
 #include <linux/stop_machine.h>
+#include <linux/tick.h>
 
 #include "rcutree.h"
 #include <trace/events/rcu.h>
@@ -62,7 +63,7 @@
 
 static struct lock_class_key rcu_node_class[NUM_RCU_LVLS];
 
-#define RCU_STATE_INITIALIZER(structname) { \
+#define RCU_STATE_INITIALIZER(structname, sabbr) { \
 	.level = { &structname##_state.node[0] }, \
 	.levelcnt = { \
 		NUM_RCU_LVL_0,  /* root of hierarchy. */ \
@@ -79,12 +80,13 @@ static struct lock_class_key rcu_node_class[NUM_RCU_LVLS];
 	.n_force_qs = 0, \
 	.n_force_qs_ngp = 0, \
 	.name = #structname, \
+	.abbr = sabbr, \
 }
 
-struct rcu_state rcu_sched_state = RCU_STATE_INITIALIZER(rcu_sched);
+struct rcu_state rcu_sched_state = RCU_STATE_INITIALIZER(rcu_sched, 's');
 DEFINE_PER_CPU(struct rcu_data, rcu_sched_data);
 
-struct rcu_state rcu_bh_state = RCU_STATE_INITIALIZER(rcu_bh);
+struct rcu_state rcu_bh_state = RCU_STATE_INITIALIZER(rcu_bh, 'b');
 DEFINE_PER_CPU(struct rcu_data, rcu_bh_data);
 
 static struct rcu_state *rcu_state;
@@ -291,12 +293,14 @@ cpu_has_callbacks_ready_to_invoke(struct rcu_data *rdp)
 
 /*
  * Does the current CPU require a yet-as-unscheduled grace period?
+ * An rcuo kthread waiting for one counts for every CPU.
  */
 static int
 cpu_needs_another_gp(struct rcu_state *rsp, struct rcu_data *rdp)
 {
-	return *rdp->nxttail[RCU_DONE_TAIL +
-			     ACCESS_ONCE(rsp->completed) != rdp->completed] &&
+	return (*rdp->nxttail[RCU_DONE_TAIL +
+			      ACCESS_ONCE(rsp->completed) != rdp->completed] ||
+		rcu_nocb_needs_gp(rsp)) &&
 	       !rcu_gp_in_progress(rsp);
 }
 
@@ -694,7 +698,16 @@ static int rcu_implicit_dynticks_qs(struct rcu_data *rdp)
 	}
 
 	/* Go check for the CPU being offline. */
-	return rcu_implicit_offline_qs(rdp);
+	if (rcu_implicit_offline_qs(rdp))
+		return 1;
+
+	/*
+	 * A full dynticks CPU may be running with its tick off: make it
+	 * notice the grace period and take the tick back.
+	 */
+	if (tick_nohz_full_cpu(rdp->cpu))
+		tick_nohz_full_kick_cpu(rdp->cpu);
+	return 0;
 }
 
 static int jiffies_till_stall_check(void)
@@ -1322,13 +1335,14 @@ rcu_check_quiescent_state(struct rcu_state *rsp, struct rcu_data *rdp)
  *
  * Note that the outgoing CPU's bit has already been cleared in the
  * cpu_online_mask.  This allows us to randomly pick a callback
- * destination from the bits set in that mask.
+ * destination from the bits set in that mask, preferring CPUs that
+ * invoke their own callbacks over no-CBs CPUs.
  */
 static void rcu_cleanup_dying_cpu(struct rcu_state *rsp)
 {
 	int i;
 	unsigned long mask;
-	int receive_cpu = cpumask_any(cpu_online_mask);
+	int receive_cpu = rcu_orphan_receive_cpu();
 	struct rcu_data *rdp = this_cpu_ptr(rsp->rda);
 	struct rcu_data *receive_rdp = per_cpu_ptr(rsp->rda, receive_cpu);
 	RCU_TRACE(struct rcu_node *rnp = rdp->mynode); /* For dying CPU. */
@@ -1824,6 +1838,12 @@ __call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *rcu),
 	local_irq_save(flags);
 	rdp = this_cpu_ptr(rsp->rda);
 
+	/* No-CBs CPUs hand their callbacks to their rcuo kthread. */
+	if (__call_rcu_nocb(rdp, head, lazy)) {
+		local_irq_restore(flags);
+		return;
+	}
+
 	/* Add the callback to our list. */
 	*rdp->nxttail[RCU_NEXT_TAIL] = head;
 	rdp->nxttail[RCU_NEXT_TAIL] = &head->next;
@@ -2168,6 +2188,19 @@ static int rcu_cpu_has_callbacks(int cpu)
 	       rcu_preempt_cpu_has_callbacks(cpu);
 }
 
+#ifdef CONFIG_NO_HZ_FULL
+/*
+ * A full dynticks CPU runs user code without an extended quiescent
+ * state, so RCU only hears from it through the tick.  Keep the tick
+ * while the CPU has callbacks or the current grace period waits on it.
+ * Called by the current CPU with interrupts disabled.
+ */
+int rcu_needs_tick(int cpu)
+{
+	return rcu_cpu_has_callbacks(cpu) || rcu_pending(cpu);
+}
+#endif /* #ifdef CONFIG_NO_HZ_FULL */
+
 static DEFINE_PER_CPU(struct rcu_head, rcu_barrier_head) = {NULL};
 static atomic_t rcu_barrier_cpu_count;
 static DEFINE_MUTEX(rcu_barrier_mutex);
@@ -2219,6 +2252,7 @@ static void _rcu_barrier(struct rcu_state *rsp,
 	 */
 	atomic_set(&rcu_barrier_cpu_count, 1);
 	on_each_cpu(rcu_barrier_func, (void *)call_rcu_func, 1);
+	rcu_nocb_barrier(rsp, rcu_barrier_callback);
 	if (atomic_dec_and_test(&rcu_barrier_cpu_count))
 		complete(&rcu_barrier_completion);
 	wait_for_completion(&rcu_barrier_completion);
@@ -2267,6 +2301,7 @@ rcu_boot_init_percpu_data(int cpu, struct rcu_state *rsp)
 	WARN_ON_ONCE(atomic_read(&rdp->dynticks->dynticks) != 1);
 	rdp->cpu = cpu;
 	rdp->rsp = rsp;
+	rcu_boot_init_nocb_percpu_data(rdp);
 	raw_spin_unlock_irqrestore(&rnp->lock, flags);
 }
 
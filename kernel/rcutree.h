@@ -27,6 +27,7 @@
 #include <linux/threads.h>
 #include <linux/cpumask.h>
 #include <linux/seqlock.h>
+#include <linux/wait.h>
 
 /*
  * Define shape of hierarchy based on NR_CPUS and CONFIG_RCU_FANOUT.
@@ -301,6 +302,20 @@ struct rcu_data {
 	unsigned long n_rp_need_fqs;
 	unsigned long n_rp_need_nothing;
 
+	/* 6) Callback offloading. */
+#ifdef CONFIG_RCU_NOCB_CPU
+	struct rcu_head *nocb_head;	/* CBs waiting for kthread. */
+	struct rcu_head **nocb_tail;
+	atomic_long_t nocb_q_count;	/* # CBs waiting for kthread */
+	atomic_long_t nocb_q_count_lazy; /*  (approximate). */
+	long nocb_p_count;		/* # CBs being invoked by kthread */
+	long nocb_p_count_lazy;		/*  (approximate). */
+	unsigned long n_nocbs_invoked;	/* count of no-CBs RCU cbs invoked. */
+	unsigned long n_nocb_gps;	/* # GPs waited for by kthread. */
+	wait_queue_head_t nocb_wq;	/* For nocb kthreads to sleep on. */
+	struct task_struct *nocb_kthread;
+#endif /* #ifdef CONFIG_RCU_NOCB_CPU */
+
 	int cpu;
 	struct rcu_state *rsp;
 };
@@ -388,6 +403,11 @@ struct rcu_state {
 	unsigned long gp_max;			/* Maximum GP duration in */
 						/*  jiffies. */
 	char *name;				/* Name of structure. */
+	char abbr;				/* Abbreviated name. */
+#ifdef CONFIG_RCU_NOCB_CPU
+	atomic_t nocb_gp_requests;		/* # rcuo kthreads waiting */
+						/*  for a grace period. */
+#endif /* #ifdef CONFIG_RCU_NOCB_CPU */
 };
 
 /* Return values for rcu_preempt_offline_tasks(). */
@@ -476,5 +496,14 @@ static void print_cpu_stall_info(struct rcu_state *rsp, int cpu);
 static void print_cpu_stall_info_end(void);
 static void zero_cpu_stall_ticks(struct rcu_data *rdp);
 static void increment_cpu_stall_ticks(void);
+static bool __call_rcu_nocb(struct rcu_data *rdp, struct rcu_head *rhp,
+			    bool lazy);
+static bool rcu_nocb_needs_gp(struct rcu_state *rsp);
+static void __init rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp);
+static void rcu_nocb_barrier(struct rcu_state *rsp,
+			     void (*func)(struct rcu_head *head));
+#ifdef CONFIG_HOTPLUG_CPU
+static int rcu_orphan_receive_cpu(void);
+#endif /* #ifdef CONFIG_HOTPLUG_CPU */
 
 #endif /* #ifndef RCU_TREE_NONCORE */
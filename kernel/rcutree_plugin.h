@@ -34,6 +34,11 @@
 #define RCU_BOOST_PRIO RCU_KTHREAD_PRIO
 #endif
 
+#ifdef CONFIG_RCU_NOCB_CPU
+static cpumask_var_t rcu_nocb_mask; /* CPUs to have callbacks offloaded. */
+static bool have_rcu_nocb_mask;	    /* Was rcu_nocb_mask allocated? */
+#endif /* #ifdef CONFIG_RCU_NOCB_CPU */
+
 /*
  * Check the RCU kernel configuration parameters and print informative
  * messages about anything out of the ordinary.  If you like #ifdef, you
@@ -70,11 +75,21 @@ static void __init rcu_bootup_announce_oddness(void)
 #if NUM_RCU_LVL_4 != 0
 	printk(KERN_INFO "\tExperimental four-level hierarchy is enabled.\n");
 #endif
+#ifdef CONFIG_RCU_NOCB_CPU
+	if (have_rcu_nocb_mask) {
+		char nocb_buf[NR_CPUS * 5];
+
+		cpumask_and(rcu_nocb_mask, rcu_nocb_mask, cpu_possible_mask);
+		cpulist_scnprintf(nocb_buf, sizeof(nocb_buf), rcu_nocb_mask);
+		printk(KERN_INFO "\tOffload RCU callbacks from CPUs: %s.\n",
+		       nocb_buf);
+	}
+#endif /* #ifdef CONFIG_RCU_NOCB_CPU */
 }
 
 #ifdef CONFIG_TREE_PREEMPT_RCU
 
-struct rcu_state rcu_preempt_state = RCU_STATE_INITIALIZER(rcu_preempt);
+struct rcu_state rcu_preempt_state = RCU_STATE_INITIALIZER(rcu_preempt, 'p');
 DEFINE_PER_CPU(struct rcu_data, rcu_preempt_data);
 static struct rcu_state *rcu_state = &rcu_preempt_state;
 
@@ -2299,3 +2314,327 @@ static void increment_cpu_stall_ticks(void)
 }
 
 #endif /* #else #ifdef CONFIG_RCU_CPU_STALL_INFO */
+
+#ifdef CONFIG_RCU_NOCB_CPU
+
+/*
+ * Offload callback processing from the boot-time-specified set of CPUs
+ * specified by rcu_nocb_mask.  For each CPU in the set, there is a
+ * kthread created that pulls the callbacks from the corresponding CPU,
+ * waits for a grace period to elapse, and invokes the callbacks.
+ * The no-CBs CPUs do a wake_up() on their kthread when they insert
+ * a callback into an empty list.
+ *
+ * A no-CBs CPU still takes part in grace periods: its quiescent states
+ * are reported by the scheduling-clock interrupt and dyntick-idle
+ * tracking exactly as before.  Only the callback invocation, and so
+ * RCU_SOFTIRQ work on behalf of its callbacks, moves to the kthread.
+ * The kthreads are not bound to any CPU, so that they can be moved to
+ * housekeeping CPUs.
+ */
+
+/* Parse the boot-time rcu_nocbs= CPU list from the kernel parameters. */
+static int __init rcu_nocb_setup(char *str)
+{
+	alloc_bootmem_cpumask_var(&rcu_nocb_mask);
+	have_rcu_nocb_mask = true;
+	cpulist_parse(str, rcu_nocb_mask);
+	return 1;
+}
+__setup("rcu_nocbs=", rcu_nocb_setup);
+
+/* Is the specified CPU a no-CBs CPU? */
+static bool is_nocb_cpu(int cpu)
+{
+	if (have_rcu_nocb_mask)
+		return cpumask_test_cpu(cpu, rcu_nocb_mask);
+	return false;
+}
+
+/*
+ * Enqueue the specified string of rcu_head structures onto the specified
+ * CPU's no-CBs lists.  The CPU is specified by rdp, the head of the
+ * string by rhp, and the tail of the string by rhtp.  The non-lazy/lazy
+ * counts are supplied by rhcount and rhcount_lazy.
+ *
+ * If warranted, also wake up the kthread servicing this CPUs queues.
+ */
+static void __call_rcu_nocb_enqueue(struct rcu_data *rdp,
+				    struct rcu_head *rhp,
+				    struct rcu_head **rhtp,
+				    int rhcount, int rhcount_lazy)
+{
+	struct rcu_head **old_rhpp;
+	struct task_struct *t;
+
+	/* Enqueue the callback on the nocb list and update counts. */
+	old_rhpp = xchg(&rdp->nocb_tail, rhtp);
+	ACCESS_ONCE(*old_rhpp) = rhp;
+	atomic_long_add(rhcount, &rdp->nocb_q_count);
+	atomic_long_add(rhcount_lazy, &rdp->nocb_q_count_lazy);
+
+	/* If the kthread exists and the queue was empty, awaken it. */
+	t = ACCESS_ONCE(rdp->nocb_kthread);
+	if (t == NULL)
+		return;
+	if (old_rhpp == &rdp->nocb_head)
+		wake_up(&rdp->nocb_wq);
+}
+
+/*
+ * This is a helper for __call_rcu(), which invokes this when the normal
+ * callback queue is inoperable.  If this is not a no-CBs CPU, this
+ * function returns failure back to __call_rcu(), which can complain
+ * appropriately.
+ *
+ * Otherwise, this function queues the callback where the corresponding
+ * "rcuo" kthread can find it.
+ */
+static bool __call_rcu_nocb(struct rcu_data *rdp, struct rcu_head *rhp,
+			    bool lazy)
+{
+	if (!is_nocb_cpu(rdp->cpu))
+		return 0;
+	__call_rcu_nocb_enqueue(rdp, rhp, &rhp->next, 1, lazy);
+	if (__is_kfree_rcu_offset((unsigned long)rhp->func))
+		trace_rcu_kfree_callback(rdp->rsp->name, rhp,
+					 (unsigned long)rhp->func,
+					 atomic_long_read(&rdp->nocb_q_count_lazy),
+					 atomic_long_read(&rdp->nocb_q_count));
+	else
+		trace_rcu_callback(rdp->rsp->name, rhp,
+				   atomic_long_read(&rdp->nocb_q_count_lazy),
+				   atomic_long_read(&rdp->nocb_q_count));
+	return 1;
+}
+
+/*
+ * Does some rcuo kthread need a grace period that nobody has started?
+ * Counted in cpu_needs_another_gp(), so that the usual machinery starts
+ * one on the kthreads' behalf.
+ */
+static bool rcu_nocb_needs_gp(struct rcu_state *rsp)
+{
+	return atomic_read(&rsp->nocb_gp_requests) != 0;
+}
+
+/*
+ * Push the grace period along on behalf of an rcuo kthread: start one
+ * if none is in progress, otherwise force quiescent states if it is
+ * time to.  The no-CBs CPUs may be sitting in dyntick-idle or running
+ * without their tick, so the kthread cannot count on them doing this.
+ */
+static void rcu_nocb_kick_gp(struct rcu_state *rsp)
+{
+	unsigned long flags;
+	struct rcu_node *rnp = rcu_get_root(rsp);
+
+	if (!rcu_gp_in_progress(rsp)) {
+		raw_spin_lock_irqsave(&rnp->lock, flags);
+		rcu_start_gp(rsp, flags);  /* releases rnp->lock. */
+	} else {
+		force_quiescent_state(rsp, 1);
+	}
+}
+
+/*
+ * Wait for a full grace period to elapse after the callbacks were
+ * removed from the queue: the one in progress now, if any, might have
+ * started before they were queued, so wait for the one after it.
+ */
+static void rcu_nocb_wait_gp(struct rcu_data *rdp)
+{
+	unsigned long c;
+	unsigned long flags;
+	struct rcu_state *rsp = rdp->rsp;
+	struct rcu_node *rnp = rcu_get_root(rsp);
+
+	raw_spin_lock_irqsave(&rnp->lock, flags);
+	c = rsp->gpnum + 1;
+	atomic_inc(&rsp->nocb_gp_requests);
+	raw_spin_unlock_irqrestore(&rnp->lock, flags);
+
+	/*
+	 * Wait for the grace period.  Do so interruptibly to avoid messing
+	 * up the load average.
+	 */
+	while (ULONG_CMP_LT(ACCESS_ONCE(rsp->completed), c)) {
+		rcu_nocb_kick_gp(rsp);
+		schedule_timeout_interruptible(1);
+	}
+	smp_mb(); /* Ensure that CB invocation happens after GP end. */
+	atomic_dec(&rsp->nocb_gp_requests);
+	rdp->n_nocb_gps++;
+}
+
+/*
+ * Per-rcu_data kthread, but only for no-CBs CPUs.  Each kthread invokes
+ * callbacks queued by the corresponding no-CBs CPU.
+ */
+static int rcu_nocb_kthread(void *arg)
+{
+	int c, cl;
+	struct rcu_head *list;
+	struct rcu_head *next;
+	struct rcu_head **tail;
+	struct rcu_data *rdp = arg;
+
+	/* Each pass through this loop invokes one batch of callbacks */
+	for (;;) {
+		/* Wait for callbacks to appear. */
+		wait_event_interruptible(rdp->nocb_wq, rdp->nocb_head);
+		list = ACCESS_ONCE(rdp->nocb_head);
+		if (!list)
+			continue;
+
+		/*
+		 * Extract queued callbacks, update counts, and wait
+		 * for a grace period to elapse.
+		 */
+		ACCESS_ONCE(rdp->nocb_head) = NULL;
+		tail = xchg(&rdp->nocb_tail, &rdp->nocb_head);
+		c = atomic_long_xchg(&rdp->nocb_q_count, 0);
+		cl = atomic_long_xchg(&rdp->nocb_q_count_lazy, 0);
+		ACCESS_ONCE(rdp->nocb_p_count) += c;
+		ACCESS_ONCE(rdp->nocb_p_count_lazy) += cl;
+		rcu_nocb_wait_gp(rdp);
+
+		/* Each pass through the following loop invokes a callback. */
+		c = cl = 0;
+		while (list) {
+			next = list->next;
+			/* Wait for enqueuing to complete, if needed. */
+			while (next == NULL && &list->next != tail) {
+				schedule_timeout_interruptible(1);
+				next = list->next;
+			}
+			debug_rcu_head_unqueue(list);
+			local_bh_disable();
+			if (__rcu_reclaim(rdp->rsp->name, list))
+				cl++;
+			c++;
+			local_bh_enable();
+			list = next;
+			cond_resched();
+		}
+		ACCESS_ONCE(rdp->nocb_p_count) -= c;
+		ACCESS_ONCE(rdp->nocb_p_count_lazy) -= cl;
+		rdp->n_nocbs_invoked += c;
+	}
+	return 0;
+}
+
+/* Initialize per-rcu_data variables for no-CBs CPUs. */
+static void __init rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp)
+{
+	rdp->nocb_tail = &rdp->nocb_head;
+	init_waitqueue_head(&rdp->nocb_wq);
+}
+
+/* Create a kthread for each RCU flavor for each no-CBs CPU. */
+static void __init rcu_spawn_nocb_kthreads(struct rcu_state *rsp)
+{
+	int cpu;
+	struct rcu_data *rdp;
+	struct task_struct *t;
+
+	for_each_cpu(cpu, rcu_nocb_mask) {
+		rdp = per_cpu_ptr(rsp->rda, cpu);
+		t = kthread_run(rcu_nocb_kthread, rdp,
+				"rcuo%c/%d", rsp->abbr, cpu);
+		BUG_ON(IS_ERR(t));
+		ACCESS_ONCE(rdp->nocb_kthread) = t;
+	}
+}
+
+static int __init rcu_spawn_nocb_kthreads_all(void)
+{
+	if (!have_rcu_nocb_mask)
+		return 0;
+#ifdef CONFIG_TREE_PREEMPT_RCU
+	rcu_spawn_nocb_kthreads(&rcu_preempt_state);
+#endif /* #ifdef CONFIG_TREE_PREEMPT_RCU */
+	rcu_spawn_nocb_kthreads(&rcu_sched_state);
+	rcu_spawn_nocb_kthreads(&rcu_bh_state);
+	return 0;
+}
+early_initcall(rcu_spawn_nocb_kthreads_all);
+
+/*
+ * rcu_barrier() posts its callback on each online CPU, but a no-CBs
+ * CPU's kthread keeps the callbacks the CPU queued before going
+ * offline.  Post a barrier callback behind those too.  These use their
+ * own rcu_head, as an online no-CBs CPU also gets rcu_barrier_head.
+ */
+static DEFINE_PER_CPU(struct rcu_head, rcu_nocb_barrier_head);
+
+static void rcu_nocb_barrier(struct rcu_state *rsp,
+			     void (*func)(struct rcu_head *head))
+{
+	int cpu;
+	struct rcu_head *rhp;
+
+	if (!have_rcu_nocb_mask)
+		return;
+	for_each_cpu(cpu, rcu_nocb_mask) {
+		rhp = &per_cpu(rcu_nocb_barrier_head, cpu);
+		rhp->func = func;
+		rhp->next = NULL;
+		atomic_inc(&rcu_barrier_cpu_count);
+		__call_rcu_nocb_enqueue(per_cpu_ptr(rsp->rda, cpu),
+					rhp, &rhp->next, 1, 0);
+	}
+}
+
+#ifdef CONFIG_HOTPLUG_CPU
+
+/*
+ * CPU whose callback lists adopt those of a dying CPU.  Prefer one
+ * that still invokes its own callbacks, so that the orphans do not
+ * end up in a no-CBs CPU's softirq.
+ */
+static int rcu_orphan_receive_cpu(void)
+{
+	int cpu;
+
+	if (have_rcu_nocb_mask)
+		for_each_online_cpu(cpu)
+			if (!cpumask_test_cpu(cpu, rcu_nocb_mask))
+				return cpu;
+	return cpumask_any(cpu_online_mask);
+}
+
+#endif /* #ifdef CONFIG_HOTPLUG_CPU */
+
+#else /* #ifdef CONFIG_RCU_NOCB_CPU */
+
+static bool __call_rcu_nocb(struct rcu_data *rdp, struct rcu_head *rhp,
+			    bool lazy)
+{
+	return 0;
+}
+
+static bool rcu_nocb_needs_gp(struct rcu_state *rsp)
+{
+	return false;
+}
+
+static void __init rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp)
+{
+}
+
+static void rcu_nocb_barrier(struct rcu_state *rsp,
+			     void (*func)(struct rcu_head *head))
+{
+}
+
+#ifdef CONFIG_HOTPLUG_CPU
+
+static int rcu_orphan_receive_cpu(void)
+{
+	return cpumask_any(cpu_online_mask);
+}
+
+#endif /* #ifdef CONFIG_HOTPLUG_CPU */
+
+#endif /* #else #ifdef CONFIG_RCU_NOCB_CPU */
@@ -90,6 +90,13 @@ static void print_one_rcu_data(struct seq_file *m, struct rcu_data *rdp)
 		   per_cpu(rcu_cpu_kthread_cpu, rdp->cpu),
 		   per_cpu(rcu_cpu_kthread_loops, rdp->cpu) & 0xffff);
 #endif /* #ifdef CONFIG_RCU_BOOST */
+#ifdef CONFIG_RCU_NOCB_CPU
+	seq_printf(m, " nq=%ld/%ld np=%ld/%ld ni=%lu ng=%lu",
+		   atomic_long_read(&rdp->nocb_q_count_lazy),
+		   atomic_long_read(&rdp->nocb_q_count),
+		   rdp->nocb_p_count_lazy, rdp->nocb_p_count,
+		   rdp->n_nocbs_invoked, rdp->n_nocb_gps);
+#endif /* #ifdef CONFIG_RCU_NOCB_CPU */
 	seq_printf(m, " b=%ld", rdp->blimit);
 	seq_printf(m, " ci=%lu co=%lu ca=%lu\n",
 		   rdp->n_cbs_invoked, rdp->n_cbs_orphaned, rdp->n_cbs_adopted);
@@ -159,6 +166,13 @@ static void print_one_rcu_data_csv(struct seq_file *m, struct rcu_data *rdp)
 		   convert_kthread_status(per_cpu(rcu_cpu_kthread_status,
 					  rdp->cpu)));
 #endif /* #ifdef CONFIG_RCU_BOOST */
+#ifdef CONFIG_RCU_NOCB_CPU
+	seq_printf(m, ",%ld,%ld,%ld,%ld,%lu,%lu",
+		   atomic_long_read(&rdp->nocb_q_count_lazy),
+		   atomic_long_read(&rdp->nocb_q_count),
+		   rdp->nocb_p_count_lazy, rdp->nocb_p_count,
+		   rdp->n_nocbs_invoked, rdp->n_nocb_gps);
+#endif /* #ifdef CONFIG_RCU_NOCB_CPU */
 	seq_printf(m, ",%ld", rdp->blimit);
 	seq_printf(m, ",%lu,%lu,%lu\n",
 		   rdp->n_cbs_invoked, rdp->n_cbs_orphaned, rdp->n_cbs_adopted);
@@ -172,6 +186,9 @@ static int show_rcudata_csv(struct seq_file *m, void *unused)
 #ifdef CONFIG_RCU_BOOST
 	seq_puts(m, "\"kt\",\"ktl\"");
 #endif /* #ifdef CONFIG_RCU_BOOST */
+#ifdef CONFIG_RCU_NOCB_CPU
+	seq_puts(m, ",\"nql\",\"nq\",\"npl\",\"np\",\"ni\",\"ng\"");
+#endif /* #ifdef CONFIG_RCU_NOCB_CPU */
 	seq_puts(m, ",\"b\",\"ci\",\"co\",\"ca\"\n");
 #ifdef CONFIG_TREE_PREEMPT_RCU
 	seq_puts(m, "\"rcu_preempt:\"\n");
@@ -337,8 +354,12 @@ static void show_one_rcugp(struct seq_file *m, struct rcu_state *rsp)
 		gpage = jiffies - rsp->gp_start;
 	gpmax = rsp->gp_max;
 	raw_spin_unlock_irqrestore(&rnp->lock, flags);
-	seq_printf(m, "%s: completed=%ld  gpnum=%lu  age=%ld  max=%ld\n",
+	seq_printf(m, "%s: completed=%ld  gpnum=%lu  age=%ld  max=%ld",
 		   rsp->name, completed, gpnum, gpage, gpmax);
+#ifdef CONFIG_RCU_NOCB_CPU
+	seq_printf(m, "  nocbgp=%d", atomic_read(&rsp->nocb_gp_requests));
+#endif /* #ifdef CONFIG_RCU_NOCB_CPU */
+	seq_putc(m, '\n');
 }
 
 static int show_rcugp(struct seq_file *m, void *unused)
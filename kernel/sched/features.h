@@ -69,3 +69,16 @@ SCHED_FEAT(TTWU_QUEUE, true)
 SCHED_FEAT(FORCE_SD_OVERLAP, false)
 SCHED_FEAT(RT_RUNTIME_SHARE, true)
 SCHED_FEAT(LB_MIN, false)
+
+#ifdef CONFIG_NUMA_BALANCING
+/*
+ * Let the load balancer move even a cache-hot task towards the node
+ * most of its NUMA hinting faults hit...
+ */
+SCHED_FEAT(NUMA_FAVOUR_HIGHER, true)
+
+/*
+ * ...and treat moving it away from that node as if it were cache-hot.
+ */
+SCHED_FEAT(NUMA_RESIST_LOWER, false)
+#endif
@@ -3,6 +3,7 @@
 #include <linux/mutex.h>
 #include <linux/spinlock.h>
 #include <linux/stop_machine.h>
+#include <linux/tick.h>
 
 #include "cpupri.h"
 
@@ -26,6 +27,15 @@ extern __read_mostly int scheduler_running;
 #define TASK_USER_PRIO(p)	USER_PRIO((p)->static_prio)
 #define MAX_USER_PRIO		(USER_PRIO(MAX_PRIO))
 
+/*
+ * Latency nice is a hint about how much scheduling delay an entity is
+ * ready to accept, it uses the same [ -20 ... 0 ... 19 ] range as nice
+ * but does not change the weight.
+ */
+#define MAX_LATENCY_NICE	19
+#define MIN_LATENCY_NICE	-20
+#define LATENCY_NICE_WIDTH	(MAX_LATENCY_NICE - MIN_LATENCY_NICE + 1)
+
 /*
  * Helpers for converting nanosecond timing to jiffy resolution
  */
@@ -43,6 +53,11 @@ extern __read_mostly int scheduler_running;
  */
 #define RUNTIME_INF	((u64)~0ULL)
 
+static inline int fair_policy(int policy)
+{
+	return policy == SCHED_NORMAL || policy == SCHED_BATCH;
+}
+
 static inline int rt_policy(int policy)
 {
 	if (policy == SCHED_FIFO || policy == SCHED_RR)
@@ -50,11 +65,35 @@ static inline int rt_policy(int policy)
 	return 0;
 }
 
+static inline int dl_policy(int policy)
+{
+	return unlikely(policy == SCHED_DEADLINE);
+}
+
 static inline int task_has_rt_policy(struct task_struct *p)
 {
 	return rt_policy(p->policy);
 }
 
+static inline int task_has_dl_policy(struct task_struct *p)
+{
+	return dl_policy(p->policy);
+}
+
+static inline bool dl_time_before(u64 a, u64 b)
+{
+	return (s64)(a - b) < 0;
+}
+
+/*
+ * Tells if entity @a should preempt entity @b.
+ */
+static inline bool
+dl_entity_preempt(struct sched_dl_entity *a, struct sched_dl_entity *b)
+{
+	return dl_time_before(a->deadline, b->deadline);
+}
+
 /*
  * This is the priority-queue data structure of the RT scheduling class:
  */
@@ -71,6 +110,18 @@ struct rt_bandwidth {
 	struct hrtimer		rt_period_timer;
 };
 
+/*
+ * Admission control bookkeeping of SCHED_DEADLINE tasks: bw is the
+ * fraction of each CPU -deadline tasks may use (sched_rt_runtime_us /
+ * sched_rt_period_us, as a ratio scaled by to_ratio()), total_bw the
+ * sum of the bandwidths already admitted.  There is one of these per
+ * root domain on SMP, one per runqueue on UP.
+ */
+struct dl_bw {
+	raw_spinlock_t lock;
+	u64 bw, total_bw;
+};
+
 extern struct mutex sched_domains_mutex;
 
 #ifdef CONFIG_CGROUP_SCHED
@@ -100,6 +151,23 @@ struct cfs_bandwidth {
 #endif
 };
 
+#ifdef CONFIG_SCHEDSTATS
+/*
+ * log2 histograms of the time a task spent waiting on a runqueue before
+ * it got the cpu, split by whether it was queued by a wakeup or put back
+ * by an involuntary switch.  Bucket 0 counts delays below 1024ns, bucket
+ * i counts [2^(i-1), 2^i) units of 1024ns and the last bucket catches
+ * everything above.  Only ever written by the owning cpu under rq->lock.
+ */
+#define SCHED_LAT_HIST_BUCKETS	24
+#define SCHED_LAT_HIST_SHIFT	10
+
+struct sched_lat_hist {
+	u64 wakeup[SCHED_LAT_HIST_BUCKETS];
+	u64 preempt[SCHED_LAT_HIST_BUCKETS];
+};
+#endif
+
 /* task group related information */
 struct task_group {
 	struct cgroup_subsys_state css;
@@ -110,8 +178,12 @@ struct task_group {
 	/* runqueue "owned" by this group on each cpu */
 	struct cfs_rq **cfs_rq;
 	unsigned long shares;
+	int latency_nice;
 
-	atomic_t load_weight;
+#ifdef CONFIG_SMP
+	atomic_long_t load_avg;
+	atomic_t runnable_avg;
+#endif
 #endif
 
 #ifdef CONFIG_RT_GROUP_SCHED
@@ -133,6 +205,11 @@ struct task_group {
 #endif
 
 	struct cfs_bandwidth cfs_bandwidth;
+
+#ifdef CONFIG_SCHEDSTATS
+	/* per-cpu runqueue delay histograms, NULL for the root group */
+	struct sched_lat_hist __percpu *lat_hist;
+#endif
 };
 
 #ifdef CONFIG_FAIR_GROUP_SCHED
@@ -181,6 +258,7 @@ extern void init_tg_cfs_entry(struct task_group *tg, struct cfs_rq *cfs_rq,
 			struct sched_entity *parent);
 extern void init_cfs_bandwidth(struct cfs_bandwidth *cfs_b);
 extern int sched_group_set_shares(struct task_group *tg, unsigned long shares);
+extern int sched_group_set_latency_nice(struct task_group *tg, int latency_nice);
 
 extern void __refill_cfs_bandwidth_runtime(struct cfs_bandwidth *cfs_b);
 extern void __start_cfs_bandwidth(struct cfs_bandwidth *cfs_b);
@@ -222,6 +300,26 @@ struct cfs_rq {
 	unsigned int nr_spread_over;
 #endif
 
+#ifdef CONFIG_SMP
+	/*
+	 * CFS load tracking: load is tracked per sched_entity and summed
+	 * up here.  runnable_load_avg is the contribution of the entities
+	 * queued on this cfs_rq, blocked_load_avg that of the ones which
+	 * went to sleep on it, decayed as they would have been had they
+	 * stayed runnable-but-idle.
+	 */
+	unsigned long runnable_load_avg, blocked_load_avg;
+	atomic64_t decay_counter;
+	u64 last_decay;
+	atomic_long_t removed_load;
+
+#ifdef CONFIG_FAIR_GROUP_SCHED
+	/* Required to track per-cpu representation of a task_group */
+	u32 tg_runnable_contrib;
+	unsigned long tg_load_contrib;
+#endif /* CONFIG_FAIR_GROUP_SCHED */
+#endif /* CONFIG_SMP */
+
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	struct rq *rq;	/* cpu runqueue to which this cfs_rq is attached */
 
@@ -245,19 +343,6 @@ struct cfs_rq {
 	 * this group.
 	 */
 	unsigned long h_load;
-
-	/*
-	 * Maintaining per-cpu shares distribution for group scheduling
-	 *
-	 * load_stamp is the last time we updated the load average
-	 * load_last is the last time we updated the load average and saw load
-	 * load_unacc_exec_time is currently unaccounted execution time
-	 */
-	u64 load_avg;
-	u64 load_period;
-	u64 load_stamp, load_last, load_unacc_exec_time;
-
-	unsigned long load_contribution;
 #endif /* CONFIG_SMP */
 #ifdef CONFIG_CFS_BANDWIDTH
 	int runtime_enabled;
@@ -265,6 +350,7 @@ struct cfs_rq {
 	s64 runtime_remaining;
 
 	u64 throttled_timestamp;
+	u64 throttled_clock_task, throttled_clock_task_time;
 	int throttled, throttle_count;
 	struct list_head throttled_list;
 #endif /* CONFIG_CFS_BANDWIDTH */
@@ -309,6 +395,41 @@ struct rt_rq {
 #endif
 };
 
+/* Deadline class' related fields in a runqueue */
+struct dl_rq {
+	/* runqueue is an rbtree, ordered by deadline */
+	struct rb_root rb_root;
+	struct rb_node *rb_leftmost;
+
+	unsigned long dl_nr_running;
+
+#ifdef CONFIG_SMP
+	/*
+	 * Deadline values of the currently executing and the
+	 * earliest ready task on this rq. Caching these facilitates
+	 * the decision wether or not a ready but not running task
+	 * should migrate somewhere else.
+	 */
+	struct {
+		u64 curr;
+		u64 next;
+	} earliest_dl;
+
+	unsigned long dl_nr_migratory;
+	int overloaded;
+
+	/*
+	 * Tasks on this rq that can be pushed away. They are kept in
+	 * an rb-tree, ordered by tasks' deadlines, with caching
+	 * of the leftmost (earliest deadline) element.
+	 */
+	struct rb_root pushable_dl_tasks_root;
+	struct rb_node *pushable_dl_tasks_leftmost;
+#else
+	struct dl_bw dl_bw;
+#endif
+};
+
 #ifdef CONFIG_SMP
 
 /*
@@ -332,6 +453,14 @@ struct root_domain {
 	 */
 	cpumask_var_t rto_mask;
 	struct cpupri cpupri;
+
+	/*
+	 * The bit corresponding to a CPU gets set here if such CPU has more
+	 * than one runnable -deadline task (as it is below for RT tasks).
+	 */
+	cpumask_var_t dlo_mask;
+	atomic_t dlo_count;
+	struct dl_bw dl_bw;
 };
 
 extern struct root_domain def_root_domain;
@@ -370,6 +499,7 @@ struct rq {
 
 	struct cfs_rq cfs;
 	struct rt_rq rt;
+	struct dl_rq dl;
 
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	/* list of leaf cfs_rq on this cpu: */
@@ -418,6 +548,9 @@ struct rq {
 	u64 age_stamp;
 	u64 idle_stamp;
 	u64 avg_idle;
+
+	/* This is used to determine avg_idle's max value */
+	u64 max_idle_balance_cost;
 #endif
 
 #ifdef CONFIG_IRQ_TIME_ACCOUNTING
@@ -458,10 +591,21 @@ struct rq {
 	/* try_to_wake_up() stats */
 	unsigned int ttwu_count;
 	unsigned int ttwu_local;
+
+	/* idle_balance() stats */
+	unsigned int newidle_lb_count;
+	unsigned int newidle_lb_skip;
+	unsigned int newidle_lb_pulled;
+
+	/* runqueue delay histograms */
+	struct sched_lat_hist lat_hist;
 #endif
 
 #ifdef CONFIG_SMP
 	struct llist_head wake_list;
+
+	/* how much of the time the rq had runnable fair tasks */
+	struct sched_avg avg;
 #endif
 };
 
@@ -482,6 +626,53 @@ DECLARE_PER_CPU(struct rq, runqueues);
 #define cpu_curr(cpu)		(cpu_rq(cpu)->curr)
 #define raw_rq()		(&__raw_get_cpu_var(runqueues))
 
+/*
+ * The SCHED_DEADLINE admission control state covering @i, and the
+ * number of CPUs whose capacity it accounts.  Callers keep the root
+ * domain stable, i.e. hold an rq lock or rcu_read_lock_sched().
+ */
+static inline struct dl_bw *dl_bw_of(int i)
+{
+#ifdef CONFIG_SMP
+	return &cpu_rq(i)->rd->dl_bw;
+#else
+	return &cpu_rq(i)->dl.dl_bw;
+#endif
+}
+
+static inline int dl_bw_cpus(int i)
+{
+#ifdef CONFIG_SMP
+	return cpumask_weight(cpu_rq(i)->rd->span);
+#else
+	return 1;
+#endif
+}
+
+/*
+ * Admitted bandwidth is charged to and released from dl_b with
+ * dl_b->lock held; p->dl.dl_bw is what @p holds, 0 once released.
+ * Each root domain rebuild recounts total_bw from the tasks it finds
+ * and bumps dl_bw_gen: a task that was already unhashed is not in the
+ * new total and must not be taken out of it.
+ */
+extern unsigned int dl_bw_gen;
+
+static inline void __dl_add(struct dl_bw *dl_b, struct task_struct *p,
+			    u64 tsk_bw)
+{
+	dl_b->total_bw += tsk_bw;
+	p->dl.dl_bw = tsk_bw;
+	p->dl.dl_bw_gen = dl_bw_gen;
+}
+
+static inline void __dl_clear(struct dl_bw *dl_b, struct task_struct *p)
+{
+	if (p->dl.dl_bw_gen == dl_bw_gen)
+		dl_b->total_bw -= min(p->dl.dl_bw, dl_b->total_bw);
+	p->dl.dl_bw = 0;
+}
+
 #ifdef CONFIG_SMP
 
 #define rcu_dereference_check_sched_domain(p) \
@@ -525,6 +716,7 @@ static inline struct sched_domain *highest_flag_domain(int cpu, int flag)
 
 DECLARE_PER_CPU(struct sched_domain *, sd_llc);
 DECLARE_PER_CPU(int, sd_llc_id);
+DECLARE_PER_CPU(struct sched_domain_shared *, sd_llc_shared);
 
 #endif /* CONFIG_SMP */
 
@@ -841,6 +1033,7 @@ enum cpuacct_stat_index {
    for (class = sched_class_highest; class; class = class->next)
 
 extern const struct sched_class stop_sched_class;
+extern const struct sched_class dl_sched_class;
 extern const struct sched_class rt_sched_class;
 extern const struct sched_class fair_sched_class;
 extern const struct sched_class idle_sched_class;
@@ -851,6 +1044,13 @@ extern const struct sched_class idle_sched_class;
 extern void trigger_load_balance(struct rq *rq, int cpu);
 extern void idle_balance(int this_cpu, struct rq *this_rq);
 
+extern void idle_enter_fair(struct rq *this_rq);
+extern void idle_exit_fair(struct rq *this_rq);
+
+#ifdef CONFIG_NUMA_BALANCING
+extern int migrate_task_to(struct task_struct *p, int cpu);
+#endif
+
 #else	/* CONFIG_SMP */
 
 static inline void idle_balance(int cpu, struct rq *rq)
@@ -865,7 +1065,9 @@ extern void update_max_interval(void);
 extern void update_group_power(struct sched_domain *sd, int cpu);
 extern int update_runtime(struct notifier_block *nfb, unsigned long action, void *hcpu);
 extern void init_sched_rt_class(void);
+extern void init_sched_dl_class(void);
 extern void init_sched_fair_class(void);
+extern void init_task_runnable_average(struct task_struct *p);
 
 extern void resched_task(struct task_struct *p);
 extern void resched_cpu(int cpu);
@@ -873,6 +1075,11 @@ extern void resched_cpu(int cpu);
 extern struct rt_bandwidth def_rt_bandwidth;
 extern void init_rt_bandwidth(struct rt_bandwidth *rt_b, u64 period, u64 runtime);
 
+extern void init_dl_bw(struct dl_bw *dl_b);
+extern void init_dl_task_timer(struct sched_dl_entity *dl_se);
+
+unsigned long to_ratio(u64 period, u64 runtime);
+
 extern void update_cpu_load(struct rq *this_rq);
 
 #ifdef CONFIG_CGROUP_CPUACCT
@@ -914,6 +1121,14 @@ static inline void cpuacct_charge(struct task_struct *tsk, u64 cputime) {}
 static inline void inc_nr_running(struct rq *rq)
 {
 	rq->nr_running++;
+
+#ifdef CONFIG_NO_HZ_FULL
+	/* A full dynticks cpu needs its tick back to preempt */
+	if (rq->nr_running == 2 && tick_nohz_full_cpu(rq->cpu)) {
+		smp_wmb();
+		tick_nohz_full_kick_cpu(rq->cpu);
+	}
+#endif
 }
 
 static inline void dec_nr_running(struct rq *rq)
@@ -1135,9 +1350,11 @@ extern struct sched_entity *__pick_first_entity(struct cfs_rq *cfs_rq);
 extern struct sched_entity *__pick_last_entity(struct cfs_rq *cfs_rq);
 extern void print_cfs_stats(struct seq_file *m, int cpu);
 extern void print_rt_stats(struct seq_file *m, int cpu);
+extern void print_dl_stats(struct seq_file *m, int cpu);
 
 extern void init_cfs_rq(struct cfs_rq *cfs_rq);
 extern void init_rt_rq(struct rt_rq *rt_rq, struct rq *rq);
+extern void init_dl_rq(struct dl_rq *dl_rq, struct rq *rq);
 extern void unthrottle_offline_cfs_rqs(struct rq *rq);
 
 extern void account_cfs_bandwidth_used(int enabled, int was_enabled);
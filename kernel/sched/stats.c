@@ -103,9 +103,55 @@ static const struct file_operations proc_schedstat_operations = {
 	.release = single_release,
 };
 
+/*
+ * bump this up when changing the format of /proc/schedstat-hist
+ */
+#define SCHEDSTAT_HIST_VERSION 1
+
+static void show_lat_hist(struct seq_file *seq, int cpu, const char *name,
+			  const u64 *hist)
+{
+	int i;
+
+	seq_printf(seq, "cpu%d %s", cpu, name);
+	for (i = 0; i < SCHED_LAT_HIST_BUCKETS; i++)
+		seq_printf(seq, " %llu", (unsigned long long)hist[i]);
+	seq_putc(seq, '\n');
+}
+
+static int show_schedstat_hist(struct seq_file *seq, void *v)
+{
+	int cpu;
+
+	seq_printf(seq, "version %d\n", SCHEDSTAT_HIST_VERSION);
+	seq_printf(seq, "timestamp %lu\n", jiffies);
+	seq_printf(seq, "buckets %d shift %d\n",
+		   SCHED_LAT_HIST_BUCKETS, SCHED_LAT_HIST_SHIFT);
+	for_each_online_cpu(cpu) {
+		struct rq *rq = cpu_rq(cpu);
+
+		show_lat_hist(seq, cpu, "wakeup", rq->lat_hist.wakeup);
+		show_lat_hist(seq, cpu, "preempt", rq->lat_hist.preempt);
+	}
+	return 0;
+}
+
+static int schedstat_hist_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, show_schedstat_hist, NULL);
+}
+
+static const struct file_operations proc_schedstat_hist_operations = {
+	.open    = schedstat_hist_open,
+	.read    = seq_read,
+	.llseek  = seq_lseek,
+	.release = single_release,
+};
+
 static int __init proc_schedstat_init(void)
 {
 	proc_create("schedstat", 0, NULL, &proc_schedstat_operations);
+	proc_create("schedstat-hist", 0, NULL, &proc_schedstat_hist_operations);
 	return 0;
 }
 module_init(proc_schedstat_init);
@@ -23,6 +23,43 @@ rq_sched_info_depart(struct rq *rq, unsigned long long delta)
 		rq->rq_cpu_time += delta;
 }
 
+static inline int sched_lat_hist_bucket(unsigned long long delta)
+{
+	int bucket = fls64(delta >> SCHED_LAT_HIST_SHIFT);
+
+	return min(bucket, SCHED_LAT_HIST_BUCKETS - 1);
+}
+
+static inline void
+sched_lat_hist_add(struct sched_lat_hist *hist, int bucket, int preempted)
+{
+	if (preempted)
+		hist->preempt[bucket]++;
+	else
+		hist->wakeup[bucket]++;
+}
+
+/*
+ * Account the runqueue delay of @t in the histograms of its rq and of
+ * every non-root group it belongs to.  Expects runqueue lock to be held,
+ * the per-cpu slots of this rq are not touched by anybody else.
+ */
+static inline void
+rq_sched_lat_hist(struct rq *rq, struct task_struct *t,
+		  unsigned long long delta)
+{
+	int bucket = sched_lat_hist_bucket(delta);
+	int preempted = t->sched_info.preempted;
+#ifdef CONFIG_CGROUP_SCHED
+	struct task_group *tg;
+
+	for (tg = t->sched_task_group; tg && tg->parent; tg = tg->parent)
+		sched_lat_hist_add(per_cpu_ptr(tg->lat_hist, cpu_of(rq)),
+				   bucket, preempted);
+#endif
+	sched_lat_hist_add(&rq->lat_hist, bucket, preempted);
+}
+
 static inline void
 rq_sched_info_dequeued(struct rq *rq, unsigned long long delta)
 {
@@ -42,6 +79,10 @@ rq_sched_info_dequeued(struct rq *rq, unsigned long long delta)
 static inline void
 rq_sched_info_depart(struct rq *rq, unsigned long long delta)
 {}
+static inline void
+rq_sched_lat_hist(struct rq *rq, struct task_struct *t,
+		  unsigned long long delta)
+{}
 # define schedstat_inc(rq, field)	do { } while (0)
 # define schedstat_add(rq, field, amt)	do { } while (0)
 # define schedstat_set(var, val)	do { } while (0)
@@ -81,9 +122,12 @@ static void sched_info_arrive(struct task_struct *t)
 {
 	unsigned long long now = task_rq(t)->clock, delta = 0;
 
-	if (t->sched_info.last_queued)
+	if (t->sched_info.last_queued) {
 		delta = now - t->sched_info.last_queued;
+		rq_sched_lat_hist(task_rq(t), t, delta);
+	}
 	sched_info_reset_dequeued(t);
+	t->sched_info.preempted = 0;
 	t->sched_info.run_delay += delta;
 	t->sched_info.last_arrival = now;
 	t->sched_info.pcount++;
@@ -117,8 +161,10 @@ static inline void sched_info_depart(struct task_struct *t)
 
 	rq_sched_info_depart(task_rq(t), delta);
 
-	if (t->state == TASK_RUNNING)
+	if (t->state == TASK_RUNNING) {
+		t->sched_info.preempted = 1;
 		sched_info_queued(t);
+	}
 }
 
 /*
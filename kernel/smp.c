@@ -12,8 +12,10 @@
 #include <linux/gfp.h>
 #include <linux/smp.h>
 #include <linux/cpu.h>
+#ifdef CONFIG_FUSEDOS                    // FUSEDOS
 #include <fusedos.h>                     // FUSEDOS
 extern fusedos_config_t* fusedos_config; // FUSEDOS
+#endif                                   // FUSEDOS
 
 #ifdef CONFIG_USE_GENERIC_SMP_HELPERS
 static struct {
@@ -675,8 +677,10 @@ void __init smp_init(void)
 	for_each_present_cpu(cpu) {
 		if (num_online_cpus() >= setup_max_cpus)
 			break;
+#if defined(CONFIG_FUSEDOS) && !defined(CONFIG_FUSEDOS_SPC_EMU) // FUSEDOS
                 if (cpu >= fusedos_config->nr_gpcs) // FUSEDOS
                         continue;                   // FUSEDOS
+#endif                                              // FUSEDOS
 		if (!cpu_online(cpu))
 			cpu_up(cpu);
 	}
@@ -20,6 +20,9 @@
 #include <linux/profile.h>
 #include <linux/sched.h>
 #include <linux/module.h>
+#include <linux/bootmem.h>
+#include <linux/posix-timers.h>
+#include <linux/perf_event.h>
 
 #include <asm/irq_regs.h>
 
@@ -123,6 +126,222 @@ static int __init setup_tick_nohz(char *str)
 
 __setup("nohz=", setup_tick_nohz);
 
+#ifdef CONFIG_NO_HZ_FULL
+/*
+ * Full dynticks: on the nohz_full= cpus the tick is also stopped while
+ * a single task runs, down to one tick per TICK_NOHZ_FULL_MAX_DEFERMENT
+ * for the scheduler and cputime accounting.  The boot cpu keeps its
+ * tick and the do_timer() duty for everybody.  Anything that needs the
+ * tick back on such a cpu (a second runnable task, an armed cpu timer,
+ * a grace period waiting on it) kicks it with a reschedule IPI; the
+ * irq_exit() that follows restarts the tick.
+ */
+cpumask_var_t tick_nohz_full_mask;
+bool tick_nohz_full_running;
+
+static void tick_nohz_stop_sched_tick(struct tick_sched *ts, ktime_t now,
+				      int cpu);
+static void tick_nohz_restart(struct tick_sched *ts, ktime_t now);
+
+static int __init tick_nohz_full_setup(char *str)
+{
+	int cpu;
+
+	alloc_bootmem_cpumask_var(&tick_nohz_full_mask);
+	if (cpulist_parse(str, tick_nohz_full_mask) < 0) {
+		pr_warning("NOHZ: Incorrect nohz_full cpumask\n");
+		return 1;
+	}
+
+	cpu = smp_processor_id();
+	if (cpumask_test_cpu(cpu, tick_nohz_full_mask)) {
+		pr_warning("NOHZ: Clearing %d from nohz_full range for timekeeping\n",
+			   cpu);
+		cpumask_clear_cpu(cpu, tick_nohz_full_mask);
+	}
+	tick_nohz_full_running = !cpumask_empty(tick_nohz_full_mask);
+
+	return 1;
+}
+__setup("nohz_full=", tick_nohz_full_setup);
+
+static int __cpuinit tick_nohz_cpu_down_callback(struct notifier_block *nfb,
+						 unsigned long action,
+						 void *hcpu)
+{
+	unsigned int cpu = (unsigned long)hcpu;
+
+	switch (action & ~CPU_TASKS_FROZEN) {
+	case CPU_DOWN_PREPARE:
+		/* The nohz_full cpus rely on the timekeeper's tick */
+		if (tick_nohz_full_running && tick_do_timer_cpu == cpu)
+			return NOTIFY_BAD;
+		break;
+	}
+	return NOTIFY_OK;
+}
+
+static char __initdata nohz_full_buf[NR_CPUS + 1];
+
+static int __init tick_nohz_full_init(void)
+{
+	if (!tick_nohz_full_running)
+		return 0;
+
+	cpu_notifier(tick_nohz_cpu_down_callback, 0);
+	cpulist_scnprintf(nohz_full_buf, sizeof(nohz_full_buf),
+			  tick_nohz_full_mask);
+	pr_info("NOHZ: Full dynticks CPUs: %s.\n", nohz_full_buf);
+
+	return 0;
+}
+core_initcall(tick_nohz_full_init);
+
+/*
+ * Kick a full dynticks cpu so that it re-evaluates its tick on the
+ * way out of the IPI.  Safe with interrupts disabled.
+ */
+void tick_nohz_full_kick_cpu(int cpu)
+{
+	if (cpu_online(cpu))
+		smp_send_reschedule(cpu);
+}
+
+void tick_nohz_full_kick_all(void)
+{
+	int cpu;
+
+	if (!tick_nohz_full_running)
+		return;
+
+	preempt_disable();
+	for_each_cpu_and(cpu, tick_nohz_full_mask, cpu_online_mask)
+		smp_send_reschedule(cpu);
+	preempt_enable();
+}
+
+static bool can_stop_full_tick(int cpu)
+{
+	WARN_ON_ONCE(!irqs_disabled());
+
+	if (cpu == tick_do_timer_cpu)
+		return false;
+
+	if (need_resched() || local_softirq_pending())
+		return false;
+
+	/* More than one runnable task needs the tick to preempt */
+	if (!sched_can_stop_tick())
+		return false;
+
+	/* Cpu timers are checked from the tick */
+	if (!posix_cpu_timers_can_stop_tick(current))
+		return false;
+
+	/* Callbacks to run or a grace period waiting on this cpu */
+	if (rcu_needs_tick(cpu))
+		return false;
+
+	/* Event multiplexing and unthrottling are done from the tick */
+	if (!perf_event_can_stop_tick())
+		return false;
+
+	return true;
+}
+
+/*
+ * Charge the ticks that were not taken since ts->idle_jiffies to @p,
+ * except the @keep most recent ones, which the caller accounts itself.
+ * Like the tick we sample: the whole stretch is user or system time
+ * depending on where @p is now.
+ */
+static void tick_nohz_full_account(struct tick_sched *ts,
+				   struct task_struct *p, int user,
+				   unsigned long keep)
+{
+	unsigned long ticks = jiffies - ts->idle_jiffies;
+
+	if (ticks > keep && ticks < LONG_MAX)
+		account_busy_ticks(p, user, ticks - keep);
+	ts->idle_jiffies = jiffies;
+}
+
+static void tick_nohz_full_restart(struct tick_sched *ts,
+				   struct task_struct *p, int user)
+{
+	ktime_t now = ktime_get();
+
+	tick_nohz_full_account(ts, p, user, 0);
+	ts->tick_stopped = 0;
+	tick_nohz_restart(ts, now);
+}
+
+static void tick_nohz_full_stop_tick(struct tick_sched *ts)
+{
+	struct pt_regs *regs = get_irq_regs();
+	int cpu = smp_processor_id();
+
+	if (!tick_nohz_full_cpu(cpu) || is_idle_task(current))
+		return;
+
+	if (unlikely(ts->nohz_mode == NOHZ_MODE_INACTIVE))
+		return;
+
+	if (!can_stop_full_tick(cpu)) {
+		if (ts->tick_stopped)
+			tick_nohz_full_restart(ts, current,
+					       regs && user_mode(regs));
+		return;
+	}
+
+	tick_nohz_stop_sched_tick(ts, ktime_get(), cpu);
+}
+
+/*
+ * A timer was queued on full dynticks @cpu; get its tick re-evaluated
+ * against the new expiry.  Another cpu is kicked.  Here, irq_exit()
+ * does it for timers queued from interrupt context; otherwise restart
+ * the stopped tick and let the next one stop it again.
+ */
+void tick_nohz_full_kick_timer(int cpu)
+{
+	struct tick_sched *ts;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	if (cpu != smp_processor_id()) {
+		tick_nohz_full_kick_cpu(cpu);
+	} else if (!in_interrupt()) {
+		ts = &__get_cpu_var(tick_cpu_sched);
+		if (ts->tick_stopped && !ts->inidle)
+			tick_nohz_full_restart(ts, current, 0);
+	}
+	local_irq_restore(flags);
+}
+
+/*
+ * Called after a context switch on a full dynticks cpu: the stopped
+ * tick belonged to @prev.  Settle its cputime and restart the tick; the
+ * next tick decides whether the new task may run without it.
+ */
+void tick_nohz_task_switch(struct task_struct *prev)
+{
+	struct tick_sched *ts;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	ts = &__get_cpu_var(tick_cpu_sched);
+	if (ts->tick_stopped && !ts->inidle)
+		tick_nohz_full_restart(ts, prev, prev->mm != NULL);
+	local_irq_restore(flags);
+}
+#else
+static inline void tick_nohz_full_stop_tick(struct tick_sched *ts) { }
+static inline void tick_nohz_full_account(struct tick_sched *ts,
+					  struct task_struct *p, int user,
+					  unsigned long keep) { }
+#endif /* CONFIG_NO_HZ_FULL */
+
 /**
  * tick_nohz_update_jiffies - update jiffies when idle was interrupted
  *
@@ -272,49 +491,19 @@ u64 get_cpu_iowait_time_us(int cpu, u64 *last_update_time)
 }
 EXPORT_SYMBOL_GPL(get_cpu_iowait_time_us);
 
-static void tick_nohz_stop_sched_tick(struct tick_sched *ts)
+/*
+ * Stop the tick, or push it out to the next timer wheel event.  Called
+ * with interrupts disabled, either from the idle loop (ts->inidle) or,
+ * with full dynticks, while a single task runs on the cpu.
+ */
+static void tick_nohz_stop_sched_tick(struct tick_sched *ts, ktime_t now,
+				      int cpu)
 {
 	unsigned long seq, last_jiffies, next_jiffies, delta_jiffies;
-	ktime_t last_update, expires, now;
+	ktime_t last_update, expires;
 	struct clock_event_device *dev = __get_cpu_var(tick_cpu_device).evtdev;
 	u64 time_delta;
-	int cpu;
-
-	cpu = smp_processor_id();
-	ts = &per_cpu(tick_cpu_sched, cpu);
-
-	now = tick_nohz_start_idle(cpu, ts);
-
-	/*
-	 * If this cpu is offline and it is the one which updates
-	 * jiffies, then give up the assignment and let it be taken by
-	 * the cpu which runs the tick timer next. If we don't drop
-	 * this here the jiffies might be stale and do_timer() never
-	 * invoked.
-	 */
-	if (unlikely(!cpu_online(cpu))) {
-		if (cpu == tick_do_timer_cpu)
-			tick_do_timer_cpu = TICK_DO_TIMER_NONE;
-	}
-
-	if (unlikely(ts->nohz_mode == NOHZ_MODE_INACTIVE))
-		return;
-
-	if (need_resched())
-		return;
-
-	if (unlikely(local_softirq_pending() && cpu_online(cpu))) {
-		static int ratelimit;
-
-		if (ratelimit < 10) {
-			printk(KERN_ERR "NOHZ: local_softirq_pending %02x\n",
-			       (unsigned int) local_softirq_pending());
-			ratelimit++;
-		}
-		return;
-	}
 
-	ts->idle_calls++;
 	/* Read jiffies and the time when jiffies were updated last */
 	do {
 		seq = read_seqbegin(&xtime_lock);
@@ -365,6 +554,14 @@ static void tick_nohz_stop_sched_tick(struct tick_sched *ts)
 			time_delta = KTIME_MAX;
 		}
 
+		/*
+		 * A busy cpu still owes the scheduler and the cputime
+		 * accounting a tick now and then.
+		 */
+		if (!ts->inidle)
+			time_delta = min_t(u64, time_delta,
+					   TICK_NOHZ_FULL_MAX_DEFERMENT);
+
 		/*
 		 * calculate the expiry time for the next timer wheel
 		 * timer. delta_jiffies >= NEXT_TIMER_MAX_DELTA signals
@@ -401,18 +598,22 @@ static void tick_nohz_stop_sched_tick(struct tick_sched *ts)
 		 * the scheduler tick in nohz_restart_sched_tick.
 		 */
 		if (!ts->tick_stopped) {
-			select_nohz_load_balancer(1);
-			calc_load_enter_idle();
+			if (ts->inidle) {
+				select_nohz_load_balancer(1);
+				calc_load_enter_idle();
+			}
 
 			ts->idle_tick = hrtimer_get_expires(&ts->sched_timer);
 			ts->tick_stopped = 1;
 			ts->idle_jiffies = last_jiffies;
 		}
 
-		ts->idle_sleeps++;
+		if (ts->inidle) {
+			ts->idle_sleeps++;
 
-		/* Mark expires */
-		ts->idle_expires = expires;
+			/* Mark expires */
+			ts->idle_expires = expires;
+		}
 
 		/*
 		 * If the expiration time == KTIME_MAX, then
@@ -446,6 +647,53 @@ out:
 	ts->sleep_length = ktime_sub(dev->next_event, now);
 }
 
+static void __tick_nohz_idle_enter(struct tick_sched *ts)
+{
+	int cpu = smp_processor_id();
+	ktime_t now;
+
+	now = tick_nohz_start_idle(cpu, ts);
+
+	/*
+	 * If this cpu is offline and it is the one which updates
+	 * jiffies, then give up the assignment and let it be taken by
+	 * the cpu which runs the tick timer next. If we don't drop
+	 * this here the jiffies might be stale and do_timer() never
+	 * invoked.
+	 */
+	if (unlikely(!cpu_online(cpu))) {
+		if (cpu == tick_do_timer_cpu)
+			tick_do_timer_cpu = TICK_DO_TIMER_NONE;
+	}
+
+	if (unlikely(ts->nohz_mode == NOHZ_MODE_INACTIVE))
+		return;
+
+	if (need_resched())
+		return;
+
+	if (unlikely(local_softirq_pending() && cpu_online(cpu))) {
+		static int ratelimit;
+
+		if (ratelimit < 10) {
+			printk(KERN_ERR "NOHZ: local_softirq_pending %02x\n",
+			       (unsigned int) local_softirq_pending());
+			ratelimit++;
+		}
+		return;
+	}
+
+	/*
+	 * With full dynticks the timekeeping cpu keeps its tick, so
+	 * that jiffies never depend on a cpu running with the tick off.
+	 */
+	if (tick_nohz_full_enabled() && cpu == tick_do_timer_cpu)
+		return;
+
+	ts->idle_calls++;
+	tick_nohz_stop_sched_tick(ts, now, cpu);
+}
+
 /**
  * tick_nohz_idle_enter - stop the idle tick from the idle task
  *
@@ -481,7 +729,7 @@ void tick_nohz_idle_enter(void)
 	 * update of the idle time accounting in tick_nohz_start_idle().
 	 */
 	ts->inidle = 1;
-	tick_nohz_stop_sched_tick(ts);
+	__tick_nohz_idle_enter(ts);
 
 	local_irq_enable();
 }
@@ -498,10 +746,10 @@ void tick_nohz_irq_exit(void)
 {
 	struct tick_sched *ts = &__get_cpu_var(tick_cpu_sched);
 
-	if (!ts->inidle)
-		return;
-
-	tick_nohz_stop_sched_tick(ts);
+	if (ts->inidle)
+		__tick_nohz_idle_enter(ts);
+	else
+		tick_nohz_full_stop_tick(ts);
 }
 
 /**
@@ -631,7 +879,8 @@ static void tick_nohz_handler(struct clock_event_device *dev)
 	 * this duty, then the jiffies update is still serialized by
 	 * xtime_lock.
 	 */
-	if (unlikely(tick_do_timer_cpu == TICK_DO_TIMER_NONE))
+	if (unlikely(tick_do_timer_cpu == TICK_DO_TIMER_NONE) &&
+	    !tick_nohz_full_cpu(cpu))
 		tick_do_timer_cpu = cpu;
 
 	/* Check, if the jiffies need an update */
@@ -648,7 +897,11 @@ static void tick_nohz_handler(struct clock_event_device *dev)
 	 */
 	if (ts->tick_stopped) {
 		touch_softlockup_watchdog();
-		ts->idle_jiffies++;
+		if (ts->inidle)
+			ts->idle_jiffies++;
+		else
+			tick_nohz_full_account(ts, current,
+					       user_mode(regs), 1);
 	}
 
 	update_process_times(user_mode(regs));
@@ -732,12 +985,12 @@ static inline void tick_check_nohz(int cpu)
 	struct tick_sched *ts = &per_cpu(tick_cpu_sched, cpu);
 	ktime_t now;
 
-	if (!ts->idle_active && !ts->tick_stopped)
+	if (!ts->idle_active && !(ts->tick_stopped && ts->inidle))
 		return;
 	now = ktime_get();
 	if (ts->idle_active)
 		tick_nohz_stop_idle(cpu, now);
-	if (ts->tick_stopped) {
+	if (ts->tick_stopped && ts->inidle) {
 		tick_nohz_update_jiffies(now);
 		tick_nohz_kick_tick(cpu, now);
 	}
@@ -747,6 +1000,9 @@ static inline void tick_check_nohz(int cpu)
 
 static inline void tick_nohz_switch_to_nohz(void) { }
 static inline void tick_check_nohz(int cpu) { }
+static inline void tick_nohz_full_account(struct tick_sched *ts,
+					  struct task_struct *p, int user,
+					  unsigned long keep) { }
 
 #endif /* NO_HZ */
 
@@ -783,7 +1039,8 @@ static enum hrtimer_restart tick_sched_timer(struct hrtimer *timer)
 	 * this duty, then the jiffies update is still serialized by
 	 * xtime_lock.
 	 */
-	if (unlikely(tick_do_timer_cpu == TICK_DO_TIMER_NONE))
+	if (unlikely(tick_do_timer_cpu == TICK_DO_TIMER_NONE) &&
+	    !tick_nohz_full_cpu(cpu))
 		tick_do_timer_cpu = cpu;
 #endif
 
@@ -806,7 +1063,11 @@ static enum hrtimer_restart tick_sched_timer(struct hrtimer *timer)
 		 */
 		if (ts->tick_stopped) {
 			touch_softlockup_watchdog();
-			ts->idle_jiffies++;
+			if (ts->inidle)
+				ts->idle_jiffies++;
+			else
+				tick_nohz_full_account(ts, current,
+						       user_mode(regs), 1);
 		}
 		update_process_times(user_mode(regs));
 		profile_tick(CPU_PROFILING);
@@ -701,6 +701,16 @@ static struct tvec_base *lock_timer_base(struct timer_list *timer,
 	}
 }
 
+/*
+ * A full dynticks cpu only sees a new timer once its tick is
+ * re-evaluated.  Called without the base lock.
+ */
+static inline void timer_kick_nohz_full(int cpu)
+{
+	if (tick_nohz_full_cpu(cpu))
+		tick_nohz_full_kick_timer(cpu);
+}
+
 static inline int
 __mod_timer(struct timer_list *timer, unsigned long expires,
 						bool pending_only, int pinned)
@@ -708,6 +718,7 @@ __mod_timer(struct timer_list *timer, unsigned long expires,
 	struct tvec_base *base, *new_base;
 	unsigned long flags;
 	int ret = 0 , cpu;
+	bool kick = false;
 
 	timer_stats_timer_set_start_info(timer);
 	BUG_ON(!timer->function);
@@ -758,10 +769,18 @@ __mod_timer(struct timer_list *timer, unsigned long expires,
 	    !tbase_get_deferrable(timer->base))
 		base->next_timer = timer->expires;
 	internal_add_timer(base, timer);
+	/*
+	 * A timer left on its old base is running there, and that cpu
+	 * re-evaluates its tick on irq_exit() anyway.
+	 */
+	kick = base == new_base && !tbase_get_deferrable(timer->base);
 
 out_unlock:
 	spin_unlock_irqrestore(&base->lock, flags);
 
+	if (kick)
+		timer_kick_nohz_full(cpu);
+
 	return ret;
 }
 
@@ -930,6 +949,9 @@ void add_timer_on(struct timer_list *timer, int cpu)
 	 */
 	wake_up_idle_cpu(cpu);
 	spin_unlock_irqrestore(&base->lock, flags);
+
+	if (!tbase_get_deferrable(timer->base))
+		timer_kick_nohz_full(cpu);
 }
 EXPORT_SYMBOL_GPL(add_timer_on);
 
@@ -14,6 +14,10 @@
 #include <linux/backing-dev.h>
 #include <linux/sysctl.h>
 #include <linux/sysfs.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
+#include <linux/cpu.h>
+#include <linux/ktime.h>
 #include "internal.h"
 
 #define CREATE_TRACE_POINTS
@@ -34,6 +38,8 @@ struct compact_control {
 	unsigned long free_pfn;		/* isolate_freepages search base */
 	unsigned long migrate_pfn;	/* isolate_migratepages search base */
 	bool sync;			/* Synchronous migration */
+	bool proactive;			/* Stop once fragmentation is low */
+	unsigned long nr_migrated;	/* Pages migrated so far */
 
 	int order;			/* order a direct compactor needs */
 	int migratetype;		/* MOVABLE, RECLAIMABLE etc */
@@ -449,6 +455,61 @@ static void update_nr_listpages(struct compact_control *cc)
 	cc->nr_freepages = nr_freepages;
 }
 
+/*
+ * How much external fragmentation kcompactd tolerates before compacting
+ * on its own: 0 disables proactive compaction, 100 tries hardest.
+ */
+int sysctl_compaction_proactiveness = 20;
+
+/*
+ * The fragmentation score of a zone is its external fragmentation at
+ * pageblock order.
+ */
+static unsigned int fragmentation_score_zone(struct zone *zone)
+{
+	return extfrag_for_order(zone, pageblock_order);
+}
+
+/*
+ * Summed up into the score of the node, a zone's score is weighted by
+ * its share of the node's memory, so that small zones hardly move it.
+ */
+static unsigned int fragmentation_score_zone_weighted(struct zone *zone)
+{
+	unsigned long score;
+
+	score = zone->present_pages * fragmentation_score_zone(zone);
+	return score / (zone->zone_pgdat->node_present_pages + 1);
+}
+
+static unsigned int fragmentation_score_node(pg_data_t *pgdat)
+{
+	unsigned int score = 0;
+	int zoneid;
+
+	for (zoneid = 0; zoneid < MAX_NR_ZONES; zoneid++) {
+		struct zone *zone = &pgdat->node_zones[zoneid];
+
+		if (!populated_zone(zone))
+			continue;
+		score += fragmentation_score_zone_weighted(zone);
+	}
+	return score;
+}
+
+/*
+ * Proactive compaction starts when the score of a node rises above
+ * the high watermark and stops when it falls below the low one.
+ */
+static unsigned int fragmentation_score_wmark(bool low)
+{
+	unsigned int wmark_low;
+
+	/* Going below 5% would only churn memory for little gain */
+	wmark_low = max(100U - sysctl_compaction_proactiveness, 5U);
+	return low ? wmark_low : min(wmark_low + 10, 100U);
+}
+
 static int compact_finished(struct zone *zone,
 			    struct compact_control *cc)
 {
@@ -462,6 +523,16 @@ static int compact_finished(struct zone *zone,
 	if (cc->free_pfn <= cc->migrate_pfn)
 		return COMPACT_COMPLETE;
 
+	if (cc->proactive) {
+		/* Don't hold up kcompactd_stop() for a whole node */
+		if (kthread_should_stop())
+			return COMPACT_PARTIAL;
+		if (fragmentation_score_zone(zone) >
+		    fragmentation_score_wmark(true))
+			return COMPACT_CONTINUE;
+		return COMPACT_PARTIAL;
+	}
+
 	/*
 	 * order == -1 is expected when compacting via
 	 * /proc/sys/vm/compact_memory
@@ -583,6 +654,7 @@ static int compact_zone(struct zone *zone, struct compact_control *cc)
 		update_nr_listpages(cc);
 		nr_remaining = cc->nr_migratepages;
 
+		cc->nr_migrated += nr_migrate - nr_remaining;
 		count_vm_event(COMPACTBLOCKS);
 		count_vm_events(COMPACTPAGES, nr_migrate - nr_remaining);
 		if (nr_remaining)
@@ -715,16 +787,6 @@ static int __compact_pgdat(pg_data_t *pgdat, struct compact_control *cc)
 	return 0;
 }
 
-int compact_pgdat(pg_data_t *pgdat, int order)
-{
-	struct compact_control cc = {
-		.order = order,
-		.sync = false,
-	};
-
-	return __compact_pgdat(pgdat, &cc);
-}
-
 static int compact_node(int nid)
 {
 	struct compact_control cc = {
@@ -770,6 +832,300 @@ int sysctl_extfrag_handler(struct ctl_table *table, int write,
 	return 0;
 }
 
+/* kcompactd looks at the fragmentation score this often */
+#define KCOMPACTD_PROACTIVE_INTERVAL_MSEC	500
+
+int sysctl_compaction_proactiveness_handler(struct ctl_table *table,
+			int write, void __user *buffer, size_t *length,
+			loff_t *ppos)
+{
+	int nid, ret;
+
+	ret = proc_dointvec_minmax(table, write, buffer, length, ppos);
+	if (ret || !write || !sysctl_compaction_proactiveness)
+		return ret;
+
+	/* kcompactd sleeps without a timeout while proactiveness is 0 */
+	for_each_online_node(nid) {
+		pg_data_t *pgdat = NODE_DATA(nid);
+
+		pgdat->proactive_compact_trigger = true;
+		wake_up_interruptible(&pgdat->kcompactd_wait);
+	}
+	return 0;
+}
+
+static bool kcompactd_work_requested(pg_data_t *pgdat)
+{
+	return pgdat->kcompactd_max_order > 0 ||
+		pgdat->proactive_compact_trigger || kthread_should_stop();
+}
+
+static bool kcompactd_node_suitable(pg_data_t *pgdat)
+{
+	enum zone_type classzone_idx = pgdat->kcompactd_classzone_idx;
+	int zoneid;
+
+	for (zoneid = 0; zoneid <= classzone_idx; zoneid++) {
+		struct zone *zone = &pgdat->node_zones[zoneid];
+
+		if (!populated_zone(zone))
+			continue;
+		if (compaction_suitable(zone, pgdat->kcompactd_max_order) ==
+							COMPACT_CONTINUE)
+			return true;
+	}
+	return false;
+}
+
+static bool should_proactive_compact_node(pg_data_t *pgdat)
+{
+	struct task_struct *kswapd = pgdat->kswapd;
+
+	if (!sysctl_compaction_proactiveness)
+		return false;
+	/* Leave the memory alone while reclaim is busy with it */
+	if (kswapd && kswapd->state == TASK_RUNNING)
+		return false;
+
+	return fragmentation_score_node(pgdat) >
+		fragmentation_score_wmark(false);
+}
+
+/* Compact the zones of a node for the order kswapd asked for */
+static unsigned long kcompactd_do_work(pg_data_t *pgdat)
+{
+	struct compact_control cc = {
+		.order = pgdat->kcompactd_max_order,
+		.sync = false,
+	};
+	enum zone_type classzone_idx = pgdat->kcompactd_classzone_idx;
+	int zoneid;
+
+	count_vm_event(KCOMPACTD_WAKE);
+
+	for (zoneid = 0; zoneid <= classzone_idx; zoneid++) {
+		struct zone *zone = &pgdat->node_zones[zoneid];
+		int status, ok;
+
+		if (!populated_zone(zone))
+			continue;
+		if (compaction_deferred(zone, cc.order))
+			continue;
+		if (compaction_suitable(zone, cc.order) != COMPACT_CONTINUE)
+			continue;
+		if (kthread_should_stop())
+			return cc.nr_migrated;
+
+		cc.nr_freepages = 0;
+		cc.nr_migratepages = 0;
+		cc.zone = zone;
+		INIT_LIST_HEAD(&cc.freepages);
+		INIT_LIST_HEAD(&cc.migratepages);
+
+		status = compact_zone(zone, &cc);
+
+		ok = zone_watermark_ok(zone, cc.order,
+				       low_wmark_pages(zone), 0, 0);
+		if (ok && cc.order >= zone->compact_order_failed)
+			zone->compact_order_failed = cc.order + 1;
+		/* Currently async compaction is never deferred. */
+		else if (!ok && status == COMPACT_COMPLETE && cc.sync)
+			defer_compaction(zone, cc.order);
+
+		VM_BUG_ON(!list_empty(&cc.freepages));
+		VM_BUG_ON(!list_empty(&cc.migratepages));
+	}
+
+	/*
+	 * Done until woken up again, unless kswapd asked for a higher
+	 * order or a lower classzone in the meantime.
+	 */
+	if (pgdat->kcompactd_max_order <= cc.order)
+		pgdat->kcompactd_max_order = 0;
+	if (pgdat->kcompactd_classzone_idx >= classzone_idx)
+		pgdat->kcompactd_classzone_idx = pgdat->nr_zones - 1;
+
+	return cc.nr_migrated;
+}
+
+/* Compact the whole node until its fragmentation score is low enough */
+static unsigned long proactive_compact_node(pg_data_t *pgdat)
+{
+	struct compact_control cc = {
+		.order = -1,
+		.sync = false,
+		.proactive = true,
+	};
+
+	count_vm_event(KCOMPACTD_PROACTIVE);
+	__compact_pgdat(pgdat, &cc);
+
+	return cc.nr_migrated;
+}
+
+/*
+ * The background compaction daemon, one per node.  It is woken by
+ * kswapd when high-order watermarks cannot be met after reclaim, and
+ * it checks the fragmentation of its node periodically to compact
+ * proactively, before anybody has to stall on a high-order allocation.
+ */
+static int kcompactd(void *p)
+{
+	pg_data_t *pgdat = (pg_data_t *)p;
+	const struct cpumask *cpumask = cpumask_of_node(pgdat->node_id);
+	unsigned int proactive_defer = 0;
+
+	if (!cpumask_empty(cpumask))
+		set_cpus_allowed_ptr(current, cpumask);
+	set_freezable();
+
+	pgdat->kcompactd_max_order = 0;
+	pgdat->kcompactd_classzone_idx = pgdat->nr_zones - 1;
+
+	while (!kthread_should_stop()) {
+		long timeout = MAX_SCHEDULE_TIMEOUT;
+		unsigned long migrated;
+		ktime_t start;
+
+		if (sysctl_compaction_proactiveness)
+			timeout = msecs_to_jiffies(
+					KCOMPACTD_PROACTIVE_INTERVAL_MSEC);
+		wait_event_freezable_timeout(pgdat->kcompactd_wait,
+				kcompactd_work_requested(pgdat), timeout);
+		if (kthread_should_stop())
+			break;
+
+		start = ktime_get();
+		if (pgdat->kcompactd_max_order) {
+			migrated = kcompactd_do_work(pgdat);
+		} else {
+			unsigned int prev_score, score;
+
+			if (pgdat->proactive_compact_trigger) {
+				pgdat->proactive_compact_trigger = false;
+				proactive_defer = 0;
+			}
+			if (!should_proactive_compact_node(pgdat))
+				continue;
+			if (proactive_defer) {
+				proactive_defer--;
+				continue;
+			}
+
+			prev_score = fragmentation_score_node(pgdat);
+			migrated = proactive_compact_node(pgdat);
+			score = fragmentation_score_node(pgdat);
+			/* Back off for a while if that did not help */
+			if (score >= prev_score)
+				proactive_defer = 1 << COMPACT_MAX_DEFER_SHIFT;
+		}
+		count_vm_events(KCOMPACTD_MIGRATED, migrated);
+		count_vm_events(KCOMPACTD_TIME,
+				ktime_to_us(ktime_sub(ktime_get(), start)));
+	}
+
+	return 0;
+}
+
+/**
+ * wakeup_kcompactd - ask kcompactd to compact a node
+ * @pgdat: node to compact
+ * @order: order of the allocations that cannot be satisfied
+ * @classzone_idx: highest zone the allocations may use
+ *
+ * Called by kswapd when reclaim alone did not meet the high-order
+ * watermarks of the node.
+ */
+void wakeup_kcompactd(pg_data_t *pgdat, int order, int classzone_idx)
+{
+	if (!order)
+		return;
+
+	if (pgdat->kcompactd_max_order < order)
+		pgdat->kcompactd_max_order = order;
+	if (pgdat->kcompactd_classzone_idx > classzone_idx)
+		pgdat->kcompactd_classzone_idx = classzone_idx;
+
+	if (!waitqueue_active(&pgdat->kcompactd_wait))
+		return;
+	if (!kcompactd_node_suitable(pgdat))
+		return;
+
+	wake_up_interruptible(&pgdat->kcompactd_wait);
+}
+
+/*
+ * This kcompactd start function will be called by init and node-hot-add.
+ */
+int kcompactd_run(int nid)
+{
+	pg_data_t *pgdat = NODE_DATA(nid);
+	int ret = 0;
+
+	if (pgdat->kcompactd)
+		return 0;
+
+	pgdat->kcompactd = kthread_run(kcompactd, pgdat, "kcompactd%d", nid);
+	if (IS_ERR(pgdat->kcompactd)) {
+		printk(KERN_ERR "Failed to start kcompactd on node %d\n", nid);
+		ret = PTR_ERR(pgdat->kcompactd);
+		pgdat->kcompactd = NULL;
+	}
+	return ret;
+}
+
+/*
+ * Called by memory hotplug when all memory in a node is offlined.  Caller must
+ * hold lock_memory_hotplug().
+ */
+void kcompactd_stop(int nid)
+{
+	struct task_struct *kcompactd = NODE_DATA(nid)->kcompactd;
+
+	if (kcompactd) {
+		kthread_stop(kcompactd);
+		NODE_DATA(nid)->kcompactd = NULL;
+	}
+}
+
+/*
+ * Like kswapd, kcompactd prefers the CPUs of its node: restore the
+ * binding when the first of them comes back online.
+ */
+static int __devinit kcompactd_cpu_callback(struct notifier_block *nfb,
+					    unsigned long action, void *hcpu)
+{
+	int nid;
+
+	if (action == CPU_ONLINE || action == CPU_ONLINE_FROZEN) {
+		for_each_node_state(nid, N_HIGH_MEMORY) {
+			pg_data_t *pgdat = NODE_DATA(nid);
+			const struct cpumask *mask;
+
+			mask = cpumask_of_node(pgdat->node_id);
+
+			if (pgdat->kcompactd &&
+			    cpumask_any_and(cpu_online_mask, mask) < nr_cpu_ids)
+				/* One of our CPUs online: restore mask */
+				set_cpus_allowed_ptr(pgdat->kcompactd, mask);
+		}
+	}
+	return NOTIFY_OK;
+}
+
+static int __init kcompactd_init(void)
+{
+	int nid;
+
+	for_each_node_state(nid, N_HIGH_MEMORY)
+		kcompactd_run(nid);
+	hotcpu_notifier(kcompactd_cpu_callback, 0);
+	return 0;
+}
+
+module_init(kcompactd_init)
+
 #if defined(CONFIG_SYSFS) && defined(CONFIG_NUMA)
 ssize_t sysfs_compact_node(struct device *dev,
 			struct device_attribute *attr,
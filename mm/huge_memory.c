@@ -17,6 +17,8 @@
 #include <linux/khugepaged.h>
 #include <linux/freezer.h>
 #include <linux/mman.h>
+#include <linux/pagemap.h>
+#include <linux/shmem_fs.h>
 #include <asm/tlb.h>
 #include <asm/pgalloc.h>
 #include "internal.h"
@@ -317,6 +319,9 @@ static struct attribute *hugepage_attr[] = {
 	&defrag_attr.attr,
 #ifdef CONFIG_DEBUG_VM
 	&debug_cow_attr.attr,
+#endif
+#ifdef CONFIG_SHMEM
+	&shmem_enabled_attr.attr,
 #endif
 	NULL,
 };
@@ -748,6 +753,94 @@ out:
 	return handle_pte_fault(mm, vma, address, pte, pmd, flags);
 }
 
+/*
+ * Map the HPAGE_PMD_NR page cache pages from @pgoff of @mapping with a
+ * single huge pmd. They must form a team, as shmem allocates them: all
+ * uptodate, physically contiguous and naturally aligned. When they do
+ * not, VM_FAULT_FALLBACK leaves the fault to be handled by ptes.
+ */
+int do_huge_pmd_file_page(struct mm_struct *mm, struct vm_area_struct *vma,
+			  unsigned long address, pmd_t *pmd,
+			  struct address_space *mapping, pgoff_t pgoff,
+			  unsigned int flags)
+{
+	unsigned long haddr = address & HPAGE_PMD_MASK;
+	struct page *head = NULL;
+	pgtable_t pgtable;
+	pmd_t entry;
+	int i, ret = VM_FAULT_FALLBACK;
+
+	for (i = 0; i < HPAGE_PMD_NR; i++) {
+		struct page *page = find_get_page(mapping, pgoff + i);
+
+		if (!page)
+			break;
+		if (!i) {
+			head = page;
+			if (page_to_pfn(head) & (HPAGE_PMD_NR - 1)) {
+				page_cache_release(page);
+				break;
+			}
+		}
+		if (page_to_pfn(page) != page_to_pfn(head) + i ||
+		    !trylock_page(page)) {
+			page_cache_release(page);
+			break;
+		}
+		/* Truncation races are resolved under the page locks */
+		if (page->mapping != mapping || !PageUptodate(page)) {
+			unlock_page(page);
+			page_cache_release(page);
+			break;
+		}
+	}
+	if (i < HPAGE_PMD_NR)
+		goto out;
+
+	pgtable = pte_alloc_one(mm, haddr);
+	if (unlikely(!pgtable)) {
+		ret = VM_FAULT_OOM;
+		goto out;
+	}
+
+	spin_lock(&mm->page_table_lock);
+	if (unlikely(!pmd_none(*pmd))) {
+		spin_unlock(&mm->page_table_lock);
+		pte_free(mm, pgtable);
+		ret = 0;
+		goto out;
+	}
+	/*
+	 * vm_page_prot carries the write permission of a shared mapping
+	 * which needs no write notification, as for a pte; the hardware
+	 * sets the dirty bit of the pmd on the first write otherwise.
+	 */
+	entry = mk_pmd(head, vma->vm_page_prot);
+	if (flags & FAULT_FLAG_WRITE)
+		entry = pmd_mkdirty(entry);
+	entry = pmd_mkhuge(entry);
+	for (i = 0; i < HPAGE_PMD_NR; i++)
+		page_add_file_rmap(head + i);
+	set_pmd_at(mm, haddr, pmd, entry);
+	prepare_pmd_huge_pte(pgtable, mm);
+	add_mm_counter(mm, MM_FILEPAGES, HPAGE_PMD_NR);
+	mm->nr_ptes++;
+	spin_unlock(&mm->page_table_lock);
+	count_vm_event(THP_FILE_MAPPED);
+
+	/* The page references are now held by the pmd mapping */
+	for (i = 0; i < HPAGE_PMD_NR; i++)
+		unlock_page(head + i);
+	return 0;
+
+out:
+	while (i--) {
+		unlock_page(head + i);
+		page_cache_release(head + i);
+	}
+	return ret;
+}
+
 int copy_huge_pmd(struct mm_struct *dst_mm, struct mm_struct *src_mm,
 		  pmd_t *dst_pmd, pmd_t *src_pmd, unsigned long addr,
 		  struct vm_area_struct *vma)
@@ -781,6 +874,12 @@ int copy_huge_pmd(struct mm_struct *dst_mm, struct mm_struct *src_mm,
 		goto out;
 	}
 	src_page = pmd_page(pmd);
+	if (!PageAnon(src_page)) {
+		/* file pmds are simply refaulted in the child */
+		pte_free(dst_mm, pgtable);
+		ret = 0;
+		goto out_unlock;
+	}
 	VM_BUG_ON(!PageHead(src_page));
 	get_page(src_page);
 	page_dup_rmap(src_page);
@@ -1003,7 +1102,7 @@ struct page *follow_trans_huge_pmd(struct mm_struct *mm,
 		goto out;
 
 	page = pmd_page(*pmd);
-	VM_BUG_ON(!PageHead(page));
+	VM_BUG_ON(PageAnon(page) && !PageHead(page));
 	if (flags & FOLL_TOUCH) {
 		pmd_t _pmd;
 		/*
@@ -1018,7 +1117,7 @@ struct page *follow_trans_huge_pmd(struct mm_struct *mm,
 		set_pmd_at(mm, addr & HPAGE_PMD_MASK, pmd, _pmd);
 	}
 	page += (addr & ~HPAGE_PMD_MASK) >> PAGE_SHIFT;
-	VM_BUG_ON(!PageCompound(page));
+	VM_BUG_ON(PageAnon(page) && !PageCompound(page));
 	if (flags & FOLL_GET)
 		get_page_foll(page);
 
@@ -1026,6 +1125,34 @@ out:
 	return page;
 }
 
+/*
+ * Called with page_table_lock held, which is dropped: the subpages of a
+ * file team are independent pages, each with its own rmap and reference.
+ */
+static void zap_huge_file_pmd(struct mmu_gather *tlb,
+			      struct vm_area_struct *vma,
+			      pmd_t orig_pmd, pgtable_t pgtable)
+{
+	struct mm_struct *mm = tlb->mm;
+	struct page *page = pmd_page(orig_pmd);
+	int i;
+
+	for (i = 0; i < HPAGE_PMD_NR; i++) {
+		if (pmd_dirty(orig_pmd))
+			set_page_dirty(page + i);
+		if (pmd_young(orig_pmd) &&
+		    likely(!VM_SequentialReadHint(vma)))
+			mark_page_accessed(page + i);
+		page_remove_rmap(page + i);
+	}
+	add_mm_counter(mm, MM_FILEPAGES, -HPAGE_PMD_NR);
+	mm->nr_ptes--;
+	spin_unlock(&mm->page_table_lock);
+	for (i = 0; i < HPAGE_PMD_NR; i++)
+		tlb_remove_page(tlb, page + i);
+	pte_free(mm, pgtable);
+}
+
 int zap_huge_pmd(struct mmu_gather *tlb, struct vm_area_struct *vma,
 		 pmd_t *pmd, unsigned long addr)
 {
@@ -1034,10 +1161,16 @@ int zap_huge_pmd(struct mmu_gather *tlb, struct vm_area_struct *vma,
 	if (__pmd_trans_huge_lock(pmd, vma) == 1) {
 		struct page *page;
 		pgtable_t pgtable;
+		pmd_t orig_pmd;
 		pgtable = get_pmd_huge_pte(tlb->mm);
-		page = pmd_page(*pmd);
+		orig_pmd = *pmd;
+		page = pmd_page(orig_pmd);
 		pmd_clear(pmd);
 		tlb_remove_pmd_tlb_entry(tlb, pmd, addr);
+		if (!PageAnon(page)) {
+			zap_huge_file_pmd(tlb, vma, orig_pmd, pgtable);
+			return 1;
+		}
 		page_remove_rmap(page);
 		VM_BUG_ON(page_mapcount(page) < 0);
 		add_mm_counter(tlb->mm, MM_ANONPAGES, -HPAGE_PMD_NR);
@@ -1193,6 +1326,38 @@ out:
 	return ret;
 }
 
+/*
+ * Like page_check_address_pmd, for a page cache page mapped as part of
+ * its team by a huge pmd. Returns with page_table_lock held on success.
+ */
+pmd_t *page_check_address_file_pmd(struct page *page,
+				   struct mm_struct *mm,
+				   unsigned long address)
+{
+	pgd_t *pgd;
+	pud_t *pud;
+	pmd_t *pmd;
+
+	pgd = pgd_offset(mm, address);
+	if (!pgd_present(*pgd))
+		return NULL;
+
+	pud = pud_offset(pgd, address);
+	if (!pud_present(*pud))
+		return NULL;
+
+	pmd = pmd_offset(pud, address);
+	if (!pmd_trans_huge(*pmd))
+		return NULL;
+
+	spin_lock(&mm->page_table_lock);
+	if (pmd_trans_huge(*pmd) && pmd_page(*pmd) +
+	    ((address & ~HPAGE_PMD_MASK) >> PAGE_SHIFT) == page)
+		return pmd;
+	spin_unlock(&mm->page_table_lock);
+	return NULL;
+}
+
 static int __split_huge_page_splitting(struct page *page,
 				       struct vm_area_struct *vma,
 				       unsigned long address)
@@ -1485,6 +1650,24 @@ out:
 #define VM_NO_THP (VM_SPECIAL|VM_INSERTPAGE|VM_MIXEDMAP|VM_SAO| \
 		   VM_HUGETLB|VM_SHARED|VM_MAYSHARE)
 
+/*
+ * Shared mappings whose ->pmd_fault maps page cache teams by huge pmds
+ * (shmem) are the exception to VM_NO_THP's VM_SHARED.
+ */
+static inline int khugepaged_file_vma(struct vm_area_struct *vma)
+{
+	return vma->vm_ops && vma->vm_ops->pmd_fault && vma->vm_file &&
+		(vma->vm_flags & VM_SHARED) &&
+		!(vma->vm_flags & (VM_NONLINEAR | VM_HUGETLB));
+}
+
+static inline unsigned long vma_no_thp_flags(struct vm_area_struct *vma)
+{
+	if (khugepaged_file_vma(vma))
+		return VM_NO_THP & ~(VM_SHARED | VM_MAYSHARE);
+	return VM_NO_THP;
+}
+
 int hugepage_madvise(struct vm_area_struct *vma,
 		     unsigned long *vm_flags, int advice)
 {
@@ -1493,7 +1676,7 @@ int hugepage_madvise(struct vm_area_struct *vma,
 		/*
 		 * Be somewhat over-protective like KSM for now!
 		 */
-		if (*vm_flags & (VM_HUGEPAGE | VM_NO_THP))
+		if (*vm_flags & (VM_HUGEPAGE | vma_no_thp_flags(vma)))
 			return -EINVAL;
 		*vm_flags &= ~VM_NOHUGEPAGE;
 		*vm_flags |= VM_HUGEPAGE;
@@ -1509,7 +1692,7 @@ int hugepage_madvise(struct vm_area_struct *vma,
 		/*
 		 * Be somewhat over-protective like KSM for now!
 		 */
-		if (*vm_flags & (VM_NOHUGEPAGE | VM_NO_THP))
+		if (*vm_flags & (VM_NOHUGEPAGE | vma_no_thp_flags(vma)))
 			return -EINVAL;
 		*vm_flags &= ~VM_HUGEPAGE;
 		*vm_flags |= VM_NOHUGEPAGE;
@@ -1637,20 +1820,21 @@ int __khugepaged_enter(struct mm_struct *mm)
 int khugepaged_enter_vma_merge(struct vm_area_struct *vma)
 {
 	unsigned long hstart, hend;
-	if (!vma->anon_vma)
+	if (!vma->anon_vma && !khugepaged_file_vma(vma))
 		/*
 		 * Not yet faulted in so we will register later in the
 		 * page fault if needed.
 		 */
 		return 0;
-	if (vma->vm_ops)
-		/* khugepaged not yet working on file or special mappings */
+	if (vma->vm_ops && !khugepaged_file_vma(vma))
+		/* khugepaged only remaps shmem teams among file mappings */
 		return 0;
 	/*
 	 * If is_pfn_mapping() is true is_learn_pfn_mapping() must be
 	 * true too, verify it here.
 	 */
-	VM_BUG_ON(is_linear_pfn_mapping(vma) || vma->vm_flags & VM_NO_THP);
+	VM_BUG_ON(is_linear_pfn_mapping(vma) ||
+		  vma->vm_flags & vma_no_thp_flags(vma));
 	hstart = (vma->vm_start + ~HPAGE_PMD_MASK) & HPAGE_PMD_MASK;
 	hend = vma->vm_end & HPAGE_PMD_MASK;
 	if (hstart < hend)
@@ -2072,6 +2256,165 @@ out:
 	return ret;
 }
 
+static pmd_t *khugepaged_pte_pmd(struct mm_struct *mm, unsigned long address)
+{
+	pgd_t *pgd;
+	pud_t *pud;
+	pmd_t *pmd;
+
+	pgd = pgd_offset(mm, address);
+	if (!pgd_present(*pgd))
+		return NULL;
+
+	pud = pud_offset(pgd, address);
+	if (!pud_present(*pud))
+		return NULL;
+
+	pmd = pmd_offset(pud, address);
+	if (!pmd_present(*pmd) || pmd_trans_huge(*pmd))
+		return NULL;
+	return pmd;
+}
+
+/*
+ * Check that the HPAGE_PMD_NR ptes at @pte map, in order, the subpages of
+ * a shmem team from the page cache of @vma's file. Returns the head page.
+ */
+static struct page *khugepaged_file_team(struct vm_area_struct *vma,
+					 unsigned long address, pte_t *pte)
+{
+	struct address_space *mapping = vma->vm_file->f_mapping;
+	pgoff_t pgoff = linear_page_index(vma, address);
+	struct page *head = NULL;
+	int i;
+
+	for (i = 0; i < HPAGE_PMD_NR; i++, address += PAGE_SIZE) {
+		pte_t pteval = pte[i];
+		struct page *page;
+
+		if (!pte_present(pteval))
+			return NULL;
+		page = vm_normal_page(vma, address, pteval);
+		if (!page || PageAnon(page) || page->mapping != mapping ||
+		    page->index != pgoff + i)
+			return NULL;
+		if (!i) {
+			head = page;
+			if (page_to_pfn(head) & (HPAGE_PMD_NR - 1))
+				return NULL;
+		} else if (page_to_pfn(page) != page_to_pfn(head) + i)
+			return NULL;
+	}
+	return head;
+}
+
+/*
+ * Map a shmem team mapped in full by ptes with a huge pmd again: the
+ * page table is retracted and deposited, no page is copied and the
+ * mapcounts are unchanged. Called with mmap_sem held for read, returns
+ * with it released.
+ */
+static void retract_file_pmd(struct mm_struct *mm, unsigned long address)
+{
+	struct vm_area_struct *vma;
+	struct address_space *mapping;
+	struct page *head;
+	pmd_t *pmd, _pmd;
+	pte_t *pte;
+	spinlock_t *ptl;
+	int i, young = 0;
+
+	up_read(&mm->mmap_sem);
+	/*
+	 * mmap_sem keeps out the page faults and i_mmap_mutex the rmap
+	 * walks and truncation, so only the hardware can touch the ptes.
+	 */
+	down_write(&mm->mmap_sem);
+	if (unlikely(khugepaged_test_exit(mm)))
+		goto out;
+
+	vma = find_vma(mm, address);
+	if (!vma || !khugepaged_file_vma(vma) ||
+	    (vma->vm_flags & VM_NOHUGEPAGE) ||
+	    address < vma->vm_start || address + HPAGE_PMD_SIZE > vma->vm_end)
+		goto out;
+
+	pmd = khugepaged_pte_pmd(mm, address);
+	if (!pmd)
+		goto out;
+
+	mapping = vma->vm_file->f_mapping;
+	mutex_lock(&mapping->i_mmap_mutex);
+
+	pte = pte_offset_map(pmd, address);
+	ptl = pte_lockptr(mm, pmd);
+
+	spin_lock(&mm->page_table_lock);
+	_pmd = pmdp_clear_flush_notify(vma, address, pmd);
+	spin_unlock(&mm->page_table_lock);
+
+	spin_lock(ptl);
+	head = khugepaged_file_team(vma, address, pte);
+	if (head) {
+		for (i = 0; i < HPAGE_PMD_NR; i++) {
+			if (pte_dirty(pte[i]))
+				set_page_dirty(head + i);
+			if (pte_young(pte[i]))
+				young = 1;
+			/* the table is deposited empty */
+			pte_clear(mm, address + i * PAGE_SIZE, pte + i);
+		}
+	}
+	spin_unlock(ptl);
+	pte_unmap(pte);
+
+	spin_lock(&mm->page_table_lock);
+	if (head) {
+		pmd_t entry = pmd_mkhuge(mk_pmd(head, vma->vm_page_prot));
+		if (!young)
+			entry = pmd_mkold(entry);
+		prepare_pmd_huge_pte(pmd_pgtable(_pmd), mm);
+		set_pmd_at(mm, address, pmd, entry);
+		update_mmu_cache(vma, address, entry);
+		khugepaged_pages_collapsed++;
+	} else {
+		/* the ptes changed since the scan: put them back */
+		pmd_populate(mm, pmd, pmd_pgtable(_pmd));
+	}
+	spin_unlock(&mm->page_table_lock);
+	mutex_unlock(&mapping->i_mmap_mutex);
+out:
+	up_write(&mm->mmap_sem);
+}
+
+static int khugepaged_scan_file_pmd(struct mm_struct *mm,
+				    struct vm_area_struct *vma,
+				    unsigned long address)
+{
+	struct page *head;
+	spinlock_t *ptl;
+	pmd_t *pmd;
+	pte_t *pte;
+
+	VM_BUG_ON(address & ~HPAGE_PMD_MASK);
+
+	if (linear_page_index(vma, address) & (HPAGE_PMD_NR - 1))
+		return 0;
+	pmd = khugepaged_pte_pmd(mm, address);
+	if (!pmd)
+		return 0;
+
+	pte = pte_offset_map_lock(mm, pmd, address, &ptl);
+	head = khugepaged_file_team(vma, address, pte);
+	pte_unmap_unlock(pte, ptl);
+	if (!head)
+		return 0;
+
+	/* retract_file_pmd will return with the mmap_sem released */
+	retract_file_pmd(mm, address);
+	return 1;
+}
+
 static void collect_mm_slot(struct mm_slot *mm_slot)
 {
 	struct mm_struct *mm = mm_slot->mm;
@@ -2142,7 +2485,8 @@ static unsigned int khugepaged_scan_mm_slot(unsigned int pages,
 			progress++;
 			continue;
 		}
-		if (!vma->anon_vma || vma->vm_ops)
+		if ((!vma->anon_vma || vma->vm_ops) &&
+		    !khugepaged_file_vma(vma))
 			goto skip;
 		if (is_vma_temporary_stack(vma))
 			goto skip;
@@ -2151,7 +2495,7 @@ static unsigned int khugepaged_scan_mm_slot(unsigned int pages,
 		 * must be true too, verify it here.
 		 */
 		VM_BUG_ON(is_linear_pfn_mapping(vma) ||
-			  vma->vm_flags & VM_NO_THP);
+			  vma->vm_flags & vma_no_thp_flags(vma));
 
 		hstart = (vma->vm_start + ~HPAGE_PMD_MASK) & HPAGE_PMD_MASK;
 		hend = vma->vm_end & HPAGE_PMD_MASK;
@@ -2172,9 +2516,13 @@ static unsigned int khugepaged_scan_mm_slot(unsigned int pages,
 			VM_BUG_ON(khugepaged_scan.address < hstart ||
 				  khugepaged_scan.address + HPAGE_PMD_SIZE >
 				  hend);
-			ret = khugepaged_scan_pmd(mm, vma,
-						  khugepaged_scan.address,
-						  hpage);
+			if (khugepaged_file_vma(vma))
+				ret = khugepaged_scan_file_pmd(mm, vma,
+						khugepaged_scan.address);
+			else
+				ret = khugepaged_scan_pmd(mm, vma,
+						khugepaged_scan.address,
+						hpage);
 			/* move to next address */
 			khugepaged_scan.address += HPAGE_PMD_SIZE;
 			progress += HPAGE_PMD_NR;
@@ -2367,8 +2715,55 @@ static int khugepaged(void *none)
 	return 0;
 }
 
-void __split_huge_page_pmd(struct mm_struct *mm, pmd_t *pmd)
+/*
+ * A file team is not a compound page: its huge pmd is replaced in place
+ * by ptes mapping the same subpages, without touching their mapcounts.
+ * The pmd is cleared and flushed first, both to collect its final dirty
+ * and young bits and to never have huge and small TLB entries loaded
+ * for the same address at once (see __split_huge_page_map).
+ */
+static void __split_huge_file_pmd(struct vm_area_struct *vma,
+				  unsigned long haddr, pmd_t *pmd)
 {
+	struct mm_struct *mm = vma->vm_mm;
+	struct page *page;
+	pgtable_t pgtable;
+	pmd_t orig_pmd, _pmd;
+	int i;
+
+	assert_spin_locked(&mm->page_table_lock);
+
+	pgtable = get_pmd_huge_pte(mm);
+	orig_pmd = pmdp_clear_flush_notify(vma, haddr, pmd);
+	page = pmd_page(orig_pmd);
+	pmd_populate(mm, &_pmd, pgtable);
+
+	for (i = 0; i < HPAGE_PMD_NR; i++) {
+		unsigned long address = haddr + i * PAGE_SIZE;
+		pte_t *pte, entry;
+
+		entry = mk_pte(page + i, vma->vm_page_prot);
+		if (pmd_write(orig_pmd))
+			entry = pte_mkwrite(entry);
+		else
+			entry = pte_wrprotect(entry);
+		if (pmd_dirty(orig_pmd))
+			entry = pte_mkdirty(entry);
+		if (!pmd_young(orig_pmd))
+			entry = pte_mkold(entry);
+		pte = pte_offset_map(&_pmd, address);
+		BUG_ON(!pte_none(*pte));
+		set_pte_at(mm, address, pte, entry);
+		pte_unmap(pte);
+	}
+	smp_wmb(); /* make pte visible before pmd */
+	pmd_populate(mm, pmd, pgtable);
+}
+
+void __split_huge_page_pmd(struct vm_area_struct *vma, unsigned long address,
+			   pmd_t *pmd)
+{
+	struct mm_struct *mm = vma->vm_mm;
 	struct page *page;
 
 	spin_lock(&mm->page_table_lock);
@@ -2378,6 +2773,11 @@ void __split_huge_page_pmd(struct mm_struct *mm, pmd_t *pmd)
 	}
 	page = pmd_page(*pmd);
 	VM_BUG_ON(!page_count(page));
+	if (!PageAnon(page)) {
+		__split_huge_file_pmd(vma, address & HPAGE_PMD_MASK, pmd);
+		spin_unlock(&mm->page_table_lock);
+		return;
+	}
 	get_page(page);
 	spin_unlock(&mm->page_table_lock);
 
@@ -2387,15 +2787,24 @@ void __split_huge_page_pmd(struct mm_struct *mm, pmd_t *pmd)
 	BUG_ON(pmd_trans_huge(*pmd));
 }
 
-static void split_huge_page_address(struct mm_struct *mm,
-				    unsigned long address)
+void split_huge_page_pmd_mm(struct mm_struct *mm, unsigned long address,
+			    pmd_t *pmd)
 {
+	struct vm_area_struct *vma;
+
+	vma = find_vma(mm, address);
+	BUG_ON(vma == NULL);
+	split_huge_page_pmd(vma, address, pmd);
+}
+
+void split_huge_page_address(struct vm_area_struct *vma,
+			     unsigned long address)
+{
+	struct mm_struct *mm = vma->vm_mm;
 	pgd_t *pgd;
 	pud_t *pud;
 	pmd_t *pmd;
 
-	VM_BUG_ON(!(address & ~HPAGE_PMD_MASK));
-
 	pgd = pgd_offset(mm, address);
 	if (!pgd_present(*pgd))
 		return;
@@ -2408,10 +2817,11 @@ static void split_huge_page_address(struct mm_struct *mm,
 	if (!pmd_present(*pmd))
 		return;
 	/*
-	 * Caller holds the mmap_sem write mode, so a huge pmd cannot
-	 * materialize from under us.
+	 * Caller holds the mmap_sem write mode, or the lock of a page the
+	 * file huge pmd would map, so a huge pmd cannot materialize from
+	 * under us.
 	 */
-	split_huge_page_pmd(mm, pmd);
+	split_huge_page_pmd(vma, address, pmd);
 }
 
 void __vma_adjust_trans_huge(struct vm_area_struct *vma,
@@ -2427,7 +2837,7 @@ void __vma_adjust_trans_huge(struct vm_area_struct *vma,
 	if (start & ~HPAGE_PMD_MASK &&
 	    (start & HPAGE_PMD_MASK) >= vma->vm_start &&
 	    (start & HPAGE_PMD_MASK) + HPAGE_PMD_SIZE <= vma->vm_end)
-		split_huge_page_address(vma->vm_mm, start);
+		split_huge_page_address(vma, start);
 
 	/*
 	 * If the new end address isn't hpage aligned and it could
@@ -2437,7 +2847,7 @@ void __vma_adjust_trans_huge(struct vm_area_struct *vma,
 	if (end & ~HPAGE_PMD_MASK &&
 	    (end & HPAGE_PMD_MASK) >= vma->vm_start &&
 	    (end & HPAGE_PMD_MASK) + HPAGE_PMD_SIZE <= vma->vm_end)
-		split_huge_page_address(vma->vm_mm, end);
+		split_huge_page_address(vma, end);
 
 	/*
 	 * If we're also updating the vma->vm_next->vm_start, if the new
@@ -2451,6 +2861,6 @@ void __vma_adjust_trans_huge(struct vm_area_struct *vma,
 		if (nstart & ~HPAGE_PMD_MASK &&
 		    (nstart & HPAGE_PMD_MASK) >= next->vm_start &&
 		    (nstart & HPAGE_PMD_MASK) + HPAGE_PMD_SIZE <= next->vm_end)
-			split_huge_page_address(next->vm_mm, nstart);
+			split_huge_page_address(next, nstart);
 	}
 }
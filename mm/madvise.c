@@ -14,6 +14,11 @@
 #include <linux/sched.h>
 #include <linux/ksm.h>
 #include <linux/file.h>
+#include <linux/swap.h>
+#include <linux/swapops.h>
+#include <linux/mmu_notifier.h>
+
+#include <asm/tlbflush.h>
 
 /*
  * Any behaviour which results in changes to the vma->vm_flags needs to
@@ -26,6 +31,7 @@ static int madvise_need_mmap_write(int behavior)
 	case MADV_REMOVE:
 	case MADV_WILLNEED:
 	case MADV_DONTNEED:
+	case MADV_FREE:
 		return 0;
 	default:
 		/* be safe, default to 1. list exceptions explicitly */
@@ -190,6 +196,125 @@ static long madvise_dontneed(struct vm_area_struct * vma,
 	return 0;
 }
 
+static int madvise_free_pte_range(pmd_t *pmd, unsigned long addr,
+				  unsigned long end, struct mm_walk *walk)
+{
+	struct vm_area_struct *vma = walk->private;
+	struct mm_struct *mm = vma->vm_mm;
+	unsigned long start = addr;
+	pte_t *orig_pte, *pte, ptent;
+	spinlock_t *ptl;
+	struct page *page;
+	int nr_swap = 0;
+	bool flush = false;
+
+	split_huge_page_pmd(vma, addr, pmd);
+	if (pmd_trans_unstable(pmd))
+		return 0;
+
+	orig_pte = pte = pte_offset_map_lock(mm, pmd, addr, &ptl);
+	arch_enter_lazy_mmu_mode();
+	for (; addr != end; pte++, addr += PAGE_SIZE) {
+		ptent = *pte;
+
+		if (pte_none(ptent))
+			continue;
+		/*
+		 * A page that is out on swap already is freed right away,
+		 * together with its swap slot.
+		 */
+		if (!pte_present(ptent)) {
+			swp_entry_t entry;
+
+			if (pte_file(ptent))
+				continue;
+			entry = pte_to_swp_entry(ptent);
+			if (non_swap_entry(entry))
+				continue;
+			nr_swap--;
+			free_swap_and_cache(entry);
+			pte_clear_not_present_full(mm, addr, pte, 0);
+			continue;
+		}
+
+		page = vm_normal_page(vma, addr, ptent);
+		if (!page)
+			continue;
+		/* Leave pages alone that someone else may still need */
+		if (PageKsm(page) || page_mapcount(page) != 1)
+			continue;
+
+		if (PageSwapCache(page) || PageDirty(page)) {
+			if (!trylock_page(page))
+				continue;
+			/* The swap copy would be as good as the page */
+			if (PageSwapCache(page) && !try_to_free_swap(page)) {
+				unlock_page(page);
+				continue;
+			}
+			ClearPageDirty(page);
+			unlock_page(page);
+		}
+
+		/*
+		 * From now on, a write sets the pte dirty bit again and
+		 * the page will be kept; otherwise reclaim just drops it.
+		 */
+		if (pte_young(ptent) || pte_dirty(ptent)) {
+			ptent = ptep_get_and_clear_full(mm, addr, pte, 0);
+			ptent = pte_mkold(ptent);
+			ptent = pte_mkclean(ptent);
+			set_pte_at(mm, addr, pte, ptent);
+			flush = true;
+		}
+		ClearPageReferenced(page);
+		deactivate_anon_page(page);
+	}
+
+	if (nr_swap)
+		add_mm_counter(mm, MM_SWAPENTS, nr_swap);
+	arch_leave_lazy_mmu_mode();
+	/* No stale writable and dirty tlb entry may survive the pte lock */
+	if (flush)
+		flush_tlb_range(vma, start, end);
+	pte_unmap_unlock(orig_pte, ptl);
+	cond_resched();
+
+	return 0;
+}
+
+/*
+ * Application no longer needs the content of the given range, but
+ * would rather not pay for refaulting it right away.  The pages are
+ * marked clean and old: if the application writes to them first,
+ * they are kept; if reclaim gets to them first, they are dropped
+ * without being swapped out and later accesses see zeroed memory.
+ */
+static long madvise_free(struct vm_area_struct *vma,
+			 struct vm_area_struct **prev,
+			 unsigned long start, unsigned long end)
+{
+	struct mm_struct *mm = vma->vm_mm;
+	struct mm_walk free_walk = {
+		.pmd_entry = madvise_free_pte_range,
+		.mm = mm,
+		.private = vma,
+	};
+
+	*prev = vma;
+	if (vma->vm_flags & (VM_LOCKED|VM_HUGETLB|VM_PFNMAP))
+		return -EINVAL;
+	/* Only private anonymous memory can be given up like this */
+	if (vma->vm_file)
+		return -EINVAL;
+
+	lru_add_drain();
+	mmu_notifier_invalidate_range_start(mm, start, end);
+	walk_page_range(start, end, &free_walk);
+	mmu_notifier_invalidate_range_end(mm, start, end);
+	return 0;
+}
+
 /*
  * Application wants to free up the pages and associated backing store.
  * This is effectively punching a hole into the middle of a file.
@@ -282,6 +407,15 @@ madvise_vma(struct vm_area_struct *vma, struct vm_area_struct **prev,
 		return madvise_remove(vma, prev, start, end);
 	case MADV_WILLNEED:
 		return madvise_willneed(vma, prev, start, end);
+	case MADV_FREE:
+		/*
+		 * Anonymous pages are only reclaimed while there is swap
+		 * space, otherwise lazily freed pages would stay around
+		 * forever: free them right away instead.
+		 */
+		if (nr_swap_pages > 0)
+			return madvise_free(vma, prev, start, end);
+		/* fall through */
 	case MADV_DONTNEED:
 		return madvise_dontneed(vma, prev, start, end);
 	default:
@@ -301,6 +435,7 @@ madvise_behavior_valid(int behavior)
 	case MADV_REMOVE:
 	case MADV_WILLNEED:
 	case MADV_DONTNEED:
+	case MADV_FREE:
 #ifdef CONFIG_KSM
 	case MADV_MERGEABLE:
 	case MADV_UNMERGEABLE:
@@ -340,6 +475,9 @@ madvise_behavior_valid(int behavior)
  *		some pages ahead.
  *  MADV_DONTNEED - the application is finished with the given range,
  *		so the kernel can free resources associated with it.
+ *  MADV_FREE - the application is finished with the content of the given
+ *		range of anonymous memory: the kernel may free the pages
+ *		under memory pressure, unless they are written to again.
  *  MADV_REMOVE - the application wants to free up the given range of
  *		pages and associated backing store.
  *  MADV_DONTFORK - omit this area from child's address space when forking:
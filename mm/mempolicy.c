@@ -511,7 +511,7 @@ static inline int check_pmd_range(struct vm_area_struct *vma, pud_t *pud,
 	pmd = pmd_offset(pud, addr);
 	do {
 		next = pmd_addr_end(addr, end);
-		split_huge_page_pmd(vma->vm_mm, pmd);
+		split_huge_page_pmd(vma, addr, pmd);
 		if (pmd_none_or_trans_huge_or_clear_bad(pmd))
 			continue;
 		if (check_pte_range(vma, pmd, addr, next, nodes,
@@ -1550,6 +1550,43 @@ struct mempolicy *get_vma_policy(struct task_struct *task,
 	return pol;
 }
 
+#ifdef CONFIG_NUMA_BALANCING
+/*
+ * mpol_misplaced - check whether the current page node is valid in policy
+ *
+ * @page   - page to be checked
+ * @vma    - vm area where page mapped
+ * @addr   - virtual address where page mapped
+ *
+ * Called from the NUMA hinting fault path.  Only local allocation (the
+ * default) is second-guessed: the page belongs on the node the task is
+ * converging on, or failing that the node it is running on.  Explicit
+ * bind, interleave and preferred policies are left to the user.
+ *
+ * Return -1 if the page is where it should be, otherwise the node id
+ * it should be moved to.
+ */
+int mpol_misplaced(struct page *page, struct vm_area_struct *vma,
+		   unsigned long addr)
+{
+	struct mempolicy *pol;
+	int curnid = page_to_nid(page);
+	int polnid = -1;
+
+	pol = get_vma_policy(current, vma, addr);
+	if (pol->mode == MPOL_PREFERRED && (pol->flags & MPOL_F_LOCAL)) {
+		polnid = current->numa_preferred_nid;
+		if (polnid < 0 || !node_online(polnid))
+			polnid = numa_node_id();
+	}
+	mpol_cond_put(pol);
+
+	if (polnid == curnid)
+		return -1;
+	return polnid;
+}
+#endif
+
 /*
  * Return a nodemask representing a mempolicy for filtering nodes for
  * page allocation
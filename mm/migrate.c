@@ -1425,4 +1425,91 @@ int migrate_vmas(struct mm_struct *mm, const nodemask_t *to,
  	}
  	return err;
 }
+
+#ifdef CONFIG_NUMA_BALANCING
+/*
+ * Returns true if this is a safe migration target node for misplaced NUMA
+ * pages.  Hinting faults must never push a node into reclaim.
+ */
+static bool migrate_balanced_pgdat(struct pglist_data *pgdat,
+				   int nr_migrate_pages)
+{
+	int z;
+
+	for (z = pgdat->nr_zones - 1; z >= 0; z--) {
+		struct zone *zone = pgdat->node_zones + z;
+
+		if (!populated_zone(zone))
+			continue;
+		if (zone->all_unreclaimable)
+			continue;
+		if (!zone_watermark_ok(zone, 0,
+				       high_wmark_pages(zone) +
+				       nr_migrate_pages,
+				       0, 0))
+			continue;
+		return true;
+	}
+	return false;
+}
+
+static struct page *alloc_misplaced_dst_page(struct page *page,
+					   unsigned long data,
+					   int **result)
+{
+	int nid = (int) data;
+
+	return alloc_pages_exact_node(nid,
+				(GFP_HIGHUSER_MOVABLE | GFP_THISNODE |
+				 __GFP_NOMEMALLOC | __GFP_NORETRY |
+				 __GFP_NOWARN) & ~GFP_IOFS, 0);
+}
+
+/*
+ * Attempt to migrate a misplaced page to the specified destination
+ * node.  The caller holds a reference on the page, which is dropped
+ * here whatever the outcome.  Returns 1 if the page was moved.
+ */
+int migrate_misplaced_page(struct page *page, int node)
+{
+	pg_data_t *pgdat = NODE_DATA(node);
+	LIST_HEAD(migratepages);
+	int nr_remaining;
+
+	/*
+	 * Don't migrate pages that are mapped in multiple processes.
+	 * TODO: Handle false sharing detection instead of this hammer
+	 */
+	if (page_mapcount(page) != 1)
+		goto out;
+
+	if (!migrate_balanced_pgdat(pgdat, 1))
+		goto out;
+
+	if (isolate_lru_page(page))
+		goto out;
+
+	inc_zone_page_state(page, NR_ISOLATED_ANON + page_is_file_cache(page));
+	list_add(&page->lru, &migratepages);
+
+	/*
+	 * isolate_lru_page() took a reference of its own, drop the
+	 * caller's so the page is not seen as pinned by migration.
+	 */
+	put_page(page);
+
+	nr_remaining = migrate_pages(&migratepages, alloc_misplaced_dst_page,
+				     node, false, MIGRATE_ASYNC);
+	if (nr_remaining) {
+		putback_lru_pages(&migratepages);
+		return 0;
+	}
+	count_vm_event(NUMA_PAGE_MIGRATE);
+	return 1;
+
+out:
+	put_page(page);
+	return 0;
+}
+#endif /* CONFIG_NUMA_BALANCING */
 #endif
@@ -696,9 +696,9 @@ int page_referenced_one(struct page *page, struct vm_area_struct *vma,
 {
 	struct mm_struct *mm = vma->vm_mm;
 	int referenced = 0;
+	pmd_t *pmd;
 
 	if (unlikely(PageTransHuge(page))) {
-		pmd_t *pmd;
 
 		spin_lock(&mm->page_table_lock);
 		/*
@@ -723,6 +723,32 @@ int page_referenced_one(struct page *page, struct vm_area_struct *vma,
 		if (pmdp_clear_flush_young_notify(vma, address, pmd))
 			referenced++;
 		spin_unlock(&mm->page_table_lock);
+	} else if (!PageAnon(page) &&
+		   (pmd = page_check_address_file_pmd(page, mm, address))) {
+		int young;
+
+		if (vma->vm_flags & VM_LOCKED) {
+			spin_unlock(&mm->page_table_lock);
+			*mapcount = 0;	/* break early from loop */
+			*vm_flags |= VM_LOCKED;
+			goto out;
+		}
+
+		/*
+		 * One young bit stands for the whole shmem team.  Every
+		 * page of the team sees it, but only the head's turn
+		 * clears it, so the other pages report the references
+		 * made since the head was last checked.
+		 */
+		if (page == pmd_page(*pmd))
+			young = pmdp_clear_flush_young_notify(vma,
+					address & HPAGE_PMD_MASK, pmd);
+		else
+			young = pmd_young(*pmd);
+		spin_unlock(&mm->page_table_lock);
+
+		if (young && likely(!VM_SequentialReadHint(vma)))
+			referenced++;
 	} else {
 		pte_t *pte;
 		spinlock_t *ptl;
@@ -1247,6 +1273,10 @@ int try_to_unmap_one(struct page *page, struct vm_area_struct *vma,
 	spinlock_t *ptl;
 	int ret = SWAP_AGAIN;
 
+	/* a shmem team mapped by a huge pmd gets unmapped page by page */
+	if (!PageAnon(page) && !PageHuge(page))
+		split_huge_page_address(vma, address);
+
 	pte = page_check_address(page, mm, address, &ptl, 0);
 	if (!pte)
 		goto out;
@@ -1292,6 +1322,15 @@ int try_to_unmap_one(struct page *page, struct vm_area_struct *vma,
 		swp_entry_t entry = { .val = page_private(page) };
 
 		if (PageSwapCache(page)) {
+			/*
+			 * Reclaim adds anon pages to swap cache clean: if
+			 * neither the page nor any pte got dirtied since
+			 * MADV_FREE, the content is not needed anymore.
+			 */
+			if ((flags & TTU_LZFREE) && !PageDirty(page)) {
+				dec_mm_counter(mm, MM_ANONPAGES);
+				goto discard;
+			}
 			/*
 			 * Store the swap location in the pte.
 			 * See handle_pte_fault() ...
@@ -1329,6 +1368,7 @@ int try_to_unmap_one(struct page *page, struct vm_area_struct *vma,
 	} else
 		dec_mm_counter(mm, MM_FILEPAGES);
 
+discard:
 	page_remove_rmap(page);
 	page_cache_release(page);
 
@@ -57,6 +57,7 @@ static struct vfsmount *shm_mnt;
 #include <linux/security.h>
 #include <linux/swapops.h>
 #include <linux/mempolicy.h>
+#include <linux/khugepaged.h>
 #include <linux/namei.h>
 #include <linux/ctype.h>
 #include <linux/migrate.h>
@@ -87,10 +88,48 @@ struct shmem_xattr {
 enum sgp_type {
 	SGP_READ,	/* don't exceed i_size, don't allocate page */
 	SGP_CACHE,	/* don't exceed i_size, may allocate page */
+	SGP_NOHUGE,	/* like SGP_CACHE, but no huge team */
+	SGP_HUGE,	/* like SGP_CACHE, huge team advised */
 	SGP_DIRTY,	/* like SGP_CACHE, but set new page dirty */
 	SGP_WRITE,	/* may exceed i_size, may allocate page */
 };
 
+/*
+ * Definitions for "huge tmpfs": tmpfs mounted with the huge= option
+ *
+ * SHMEM_HUGE_NEVER:
+ *	disables huge pages for the mount;
+ * SHMEM_HUGE_ALWAYS:
+ *	enables huge pages for the mount;
+ * SHMEM_HUGE_WITHIN_SIZE:
+ *	only allocate huge pages if the page will be fully within i_size,
+ *	also respect madvise() hints;
+ * SHMEM_HUGE_ADVISE:
+ *	only allocate huge pages if requested with madvise();
+ */
+#define SHMEM_HUGE_NEVER	0
+#define SHMEM_HUGE_ALWAYS	1
+#define SHMEM_HUGE_WITHIN_SIZE	2
+#define SHMEM_HUGE_ADVISE	3
+
+/*
+ * Special values, only for /sys/kernel/mm/transparent_hugepage/shmem_enabled:
+ *
+ * SHMEM_HUGE_DENY:
+ *	disables huge on shm_mnt and all mounts, for emergency use;
+ * SHMEM_HUGE_FORCE:
+ *	enables huge on shm_mnt and all mounts, w/o needing option, for testing;
+ */
+#define SHMEM_HUGE_DENY		(-1)
+#define SHMEM_HUGE_FORCE	(-2)
+
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+/* ifdef here to avoid bloating shmem.o when not necessary */
+static int shmem_huge __read_mostly;
+#else
+#define shmem_huge SHMEM_HUGE_DENY
+#endif
+
 #ifdef CONFIG_TMPFS
 static unsigned long shmem_default_max_blocks(void)
 {
@@ -142,10 +181,11 @@ static inline void shmem_unacct_size(unsigned long flags, loff_t size)
  * shmem_getpage reports shmem_acct_block failure as -ENOSPC not -ENOMEM,
  * so that a failure on a sparse tmpfs mapping will give SIGBUS not OOM.
  */
-static inline int shmem_acct_block(unsigned long flags)
+static inline int shmem_acct_block(unsigned long flags, long pages)
 {
 	return (flags & VM_NORESERVE) ?
-		security_vm_enough_memory_mm(current->mm, VM_ACCT(PAGE_CACHE_SIZE)) : 0;
+		security_vm_enough_memory_mm(current->mm,
+			pages * VM_ACCT(PAGE_CACHE_SIZE)) : 0;
 }
 
 static inline void shmem_unacct_blocks(unsigned long flags, long pages)
@@ -170,6 +210,16 @@ static struct backing_dev_info shmem_backing_dev_info  __read_mostly = {
 static LIST_HEAD(shmem_swaplist);
 static DEFINE_MUTEX(shmem_swaplist_mutex);
 
+/*
+ * shmem/tmpfs keeps swap entries in its page cache radix tree, whereas
+ * other mappings may only hold reclaim's shadow entries there.
+ */
+bool shmem_mapping(struct address_space *mapping)
+{
+	return mapping->backing_dev_info == &shmem_backing_dev_info;
+}
+EXPORT_SYMBOL_GPL(shmem_mapping);
+
 static int shmem_reserve_inode(struct super_block *sb)
 {
 	struct shmem_sb_info *sbinfo = SHMEM_SB(sb);
@@ -828,6 +878,25 @@ static struct page *shmem_alloc_page(gfp_t gfp,
 	 */
 	return alloc_page_vma(gfp, &pvma, 0);
 }
+
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+static struct page *shmem_alloc_hugepage(gfp_t gfp,
+			struct shmem_inode_info *info, pgoff_t hindex)
+{
+	struct vm_area_struct pvma;
+
+	/* Create a pseudo vma that just contains the policy */
+	pvma.vm_start = 0;
+	pvma.vm_pgoff = hindex;
+	pvma.vm_ops = NULL;
+	pvma.vm_policy = mpol_shared_policy_lookup(&info->policy, hindex);
+
+	/*
+	 * alloc_pages_vma() will drop the shared policy reference
+	 */
+	return alloc_pages_vma(gfp, HPAGE_PMD_ORDER, &pvma, 0, numa_node_id());
+}
+#endif
 #else /* !CONFIG_NUMA */
 #ifdef CONFIG_TMPFS
 static inline void shmem_show_mpol(struct seq_file *seq, struct mempolicy *mpol)
@@ -846,6 +915,14 @@ static inline struct page *shmem_alloc_page(gfp_t gfp,
 {
 	return alloc_page(gfp);
 }
+
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+static inline struct page *shmem_alloc_hugepage(gfp_t gfp,
+			struct shmem_inode_info *info, pgoff_t hindex)
+{
+	return alloc_pages(gfp, HPAGE_PMD_ORDER);
+}
+#endif
 #endif /* CONFIG_NUMA */
 
 #if !defined(CONFIG_NUMA) || !defined(CONFIG_TMPFS)
@@ -855,6 +932,199 @@ static inline struct mempolicy *shmem_get_sbmpol(struct shmem_sb_info *sbinfo)
 }
 #endif
 
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+/*
+ * Should a fault or write at this index try to populate the whole
+ * HPAGE_PMD_SIZE extent around it as one huge team?
+ */
+static bool shmem_huge_wanted(struct inode *inode, pgoff_t index,
+			      enum sgp_type sgp)
+{
+	pgoff_t hindex = round_down(index, HPAGE_PMD_NR);
+	loff_t i_size;
+
+	if (shmem_huge == SHMEM_HUGE_DENY)
+		return false;
+	if (sgp == SGP_READ || sgp == SGP_NOHUGE || sgp == SGP_DIRTY)
+		return false;
+	if (shmem_huge == SHMEM_HUGE_FORCE)
+		return true;
+
+	switch (SHMEM_SB(inode->i_sb)->huge) {
+	case SHMEM_HUGE_ALWAYS:
+		return true;
+	case SHMEM_HUGE_WITHIN_SIZE:
+		i_size = round_up(i_size_read(inode), PAGE_CACHE_SIZE);
+		if ((i_size >> PAGE_CACHE_SHIFT) >= hindex + HPAGE_PMD_NR)
+			return true;
+		/* fallthrough */
+	case SHMEM_HUGE_ADVISE:
+		return sgp == SGP_HUGE;
+	default:
+		return false;
+	}
+}
+
+/*
+ * shmem_alloc_team - populate an empty, aligned HPAGE_PMD_SIZE extent
+ *
+ * A high-order page is allocated and split into HPAGE_PMD_NR ordinary
+ * page cache pages: each keeps its own count, rmap, swap and truncation
+ * behaviour, but while the team stays intact in the cache its pages are
+ * physically contiguous and may be mapped by a single huge pmd.
+ *
+ * Returns 0 if the whole team was inserted, or an error if the caller
+ * should fall back to a small page (any partial team is left in place).
+ */
+static int shmem_alloc_team(struct inode *inode, pgoff_t index, gfp_t gfp)
+{
+	struct address_space *mapping = inode->i_mapping;
+	struct shmem_inode_info *info = SHMEM_I(inode);
+	struct shmem_sb_info *sbinfo = SHMEM_SB(inode->i_sb);
+	pgoff_t hindex = round_down(index, HPAGE_PMD_NR);
+	struct page *page;
+	pgoff_t indices[1];
+	int error = 0;
+	int nr;
+	int i;
+
+	/* Only worth trying when nothing is cached or swapped in the extent */
+	if (shmem_find_get_pages_and_swap(mapping, hindex, 1, &page, indices)) {
+		if (!radix_tree_exceptional_entry(page))
+			page_cache_release(page);
+		if (indices[0] < hindex + HPAGE_PMD_NR)
+			return -EEXIST;
+	}
+
+	if (shmem_acct_block(info->flags, HPAGE_PMD_NR))
+		return -ENOSPC;
+	if (sbinfo->max_blocks) {
+		if (sbinfo->max_blocks < HPAGE_PMD_NR ||
+		    percpu_counter_compare(&sbinfo->used_blocks,
+				sbinfo->max_blocks - HPAGE_PMD_NR) > 0) {
+			error = -ENOSPC;
+			goto unacct;
+		}
+		percpu_counter_add(&sbinfo->used_blocks, HPAGE_PMD_NR);
+	}
+
+	gfp |= __GFP_NORETRY | __GFP_NOWARN | __GFP_NO_KSWAPD;
+	if (!test_bit(TRANSPARENT_HUGEPAGE_DEFRAG_FLAG,
+		      &transparent_hugepage_flags))
+		gfp &= ~__GFP_WAIT;
+	page = shmem_alloc_hugepage(gfp, info, hindex);
+	if (!page) {
+		error = -ENOMEM;
+		goto decused;
+	}
+	count_vm_event(THP_FILE_ALLOC);
+	split_page(page, HPAGE_PMD_ORDER);
+
+	for (i = 0; i < HPAGE_PMD_NR; i++) {
+		struct page *subpage = page + i;
+
+		SetPageSwapBacked(subpage);
+		__set_page_locked(subpage);
+		error = mem_cgroup_cache_charge(subpage, current->mm,
+						gfp & GFP_RECLAIM_MASK);
+		if (!error)
+			error = shmem_add_to_page_cache(subpage, mapping,
+						hindex + i, gfp, NULL);
+		if (error)
+			break;
+		lru_cache_add_anon(subpage);
+		clear_highpage(subpage);
+		flush_dcache_page(subpage);
+		SetPageUptodate(subpage);
+	}
+	nr = i;
+
+	if (nr) {
+		spin_lock(&info->lock);
+		info->alloced += nr;
+		inode->i_blocks += BLOCKS_PER_PAGE * nr;
+		shmem_recalc_inode(inode);
+		spin_unlock(&info->lock);
+	}
+
+	/* The page cache holds its own references on the inserted pages */
+	for (i = 0; i < HPAGE_PMD_NR; i++) {
+		if (i <= nr)
+			unlock_page(page + i);
+		page_cache_release(page + i);
+	}
+	if (nr == HPAGE_PMD_NR)
+		return 0;
+
+	if (sbinfo->max_blocks)
+		percpu_counter_add(&sbinfo->used_blocks, nr - HPAGE_PMD_NR);
+	shmem_unacct_blocks(info->flags, HPAGE_PMD_NR - nr);
+	count_vm_event(THP_FILE_FALLBACK);
+	return error;
+
+decused:
+	if (sbinfo->max_blocks)
+		percpu_counter_add(&sbinfo->used_blocks, -HPAGE_PMD_NR);
+unacct:
+	shmem_unacct_blocks(info->flags, HPAGE_PMD_NR);
+	count_vm_event(THP_FILE_FALLBACK);
+	return error;
+}
+#else
+static inline bool shmem_huge_wanted(struct inode *inode, pgoff_t index,
+				     enum sgp_type sgp)
+{
+	return false;
+}
+
+static inline int shmem_alloc_team(struct inode *inode, pgoff_t index,
+				   gfp_t gfp)
+{
+	return -EINVAL;
+}
+#endif /* CONFIG_TRANSPARENT_HUGEPAGE */
+
+#if defined(CONFIG_TRANSPARENT_HUGEPAGE) && \
+    (defined(CONFIG_SYSFS) || defined(CONFIG_TMPFS))
+static int shmem_parse_huge(const char *str)
+{
+	if (!strcmp(str, "never"))
+		return SHMEM_HUGE_NEVER;
+	if (!strcmp(str, "always"))
+		return SHMEM_HUGE_ALWAYS;
+	if (!strcmp(str, "within_size"))
+		return SHMEM_HUGE_WITHIN_SIZE;
+	if (!strcmp(str, "advise"))
+		return SHMEM_HUGE_ADVISE;
+	if (!strcmp(str, "deny"))
+		return SHMEM_HUGE_DENY;
+	if (!strcmp(str, "force"))
+		return SHMEM_HUGE_FORCE;
+	return -EINVAL;
+}
+
+static const char *shmem_format_huge(int huge)
+{
+	switch (huge) {
+	case SHMEM_HUGE_NEVER:
+		return "never";
+	case SHMEM_HUGE_ALWAYS:
+		return "always";
+	case SHMEM_HUGE_WITHIN_SIZE:
+		return "within_size";
+	case SHMEM_HUGE_ADVISE:
+		return "advise";
+	case SHMEM_HUGE_DENY:
+		return "deny";
+	case SHMEM_HUGE_FORCE:
+		return "force";
+	default:
+		VM_BUG_ON(1);
+		return "bad_val";
+	}
+}
+#endif
+
 /*
  * shmem_getpage_gfp - find page in cache, or get from swap, or allocate
  *
@@ -872,12 +1142,13 @@ static int shmem_getpage_gfp(struct inode *inode, pgoff_t index,
 	swp_entry_t swap;
 	int error;
 	int once = 0;
+	bool huge_tried = false;
 
 	if (index > (MAX_LFS_FILESIZE >> PAGE_CACHE_SHIFT))
 		return -EFBIG;
 repeat:
 	swap.val = 0;
-	page = find_lock_page(mapping, index);
+	page = find_lock_entry(mapping, index);
 	if (radix_tree_exceptional_entry(page)) {
 		swap = radix_to_swp_entry(page);
 		page = NULL;
@@ -956,7 +1227,13 @@ repeat:
 		swap_free(swap);
 
 	} else {
-		if (shmem_acct_block(info->flags)) {
+		if (!huge_tried && shmem_huge_wanted(inode, index, sgp)) {
+			huge_tried = true;
+			if (!shmem_alloc_team(inode, index, gfp))
+				goto repeat;
+		}
+
+		if (shmem_acct_block(info->flags, 1)) {
 			error = -ENOSPC;
 			goto failed;
 		}
@@ -1025,7 +1302,7 @@ unacct:
 	shmem_unacct_blocks(info->flags, 1);
 failed:
 	if (swap.val && error != -EINVAL) {
-		struct page *test = find_get_page(mapping, index);
+		struct page *test = find_get_entry(mapping, index);
 		if (test && !radix_tree_exceptional_entry(test))
 			page_cache_release(test);
 		/* Have another try if the entry has changed */
@@ -1051,10 +1328,18 @@ failed:
 static int shmem_fault(struct vm_area_struct *vma, struct vm_fault *vmf)
 {
 	struct inode *inode = vma->vm_file->f_path.dentry->d_inode;
+	enum sgp_type sgp = SGP_CACHE;
 	int error;
 	int ret = VM_FAULT_LOCKED;
 
-	error = shmem_getpage(inode, vmf->pgoff, &vmf->page, SGP_CACHE, &ret);
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	if (vma->vm_flags & VM_HUGEPAGE)
+		sgp = SGP_HUGE;
+	else if (vma->vm_flags & VM_NOHUGEPAGE)
+		sgp = SGP_NOHUGE;
+#endif
+
+	error = shmem_getpage(inode, vmf->pgoff, &vmf->page, sgp, &ret);
 	if (error)
 		return ((error == -ENOMEM) ? VM_FAULT_OOM : VM_FAULT_SIGBUS);
 
@@ -1065,6 +1350,59 @@ static int shmem_fault(struct vm_area_struct *vma, struct vm_fault *vmf)
 	return ret;
 }
 
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+/*
+ * Map a whole team with one pmd when the faulting extent is suitably
+ * aligned in both the file and the vma, and is not shared with a
+ * private COW mapping: otherwise fall back to shmem_fault on the ptes.
+ */
+static int shmem_pmd_fault(struct vm_area_struct *vma, unsigned long address,
+			   pmd_t *pmd, unsigned int flags)
+{
+	struct inode *inode = vma->vm_file->f_path.dentry->d_inode;
+	unsigned long haddr = address & HPAGE_PMD_MASK;
+	enum sgp_type sgp = SGP_CACHE;
+	struct page *page;
+	pgoff_t pgoff;
+	loff_t i_size;
+	int error;
+	int ret = 0;
+
+	if (shmem_huge == SHMEM_HUGE_DENY)
+		return VM_FAULT_FALLBACK;
+	if (!(vma->vm_flags & VM_SHARED) ||
+	    (vma->vm_flags & (VM_NOHUGEPAGE | VM_NONLINEAR | VM_LOCKED)))
+		return VM_FAULT_FALLBACK;
+	if (haddr < vma->vm_start || haddr + HPAGE_PMD_SIZE > vma->vm_end)
+		return VM_FAULT_FALLBACK;
+	pgoff = linear_page_index(vma, haddr);
+	if (pgoff & (HPAGE_PMD_NR - 1))
+		return VM_FAULT_FALLBACK;
+	i_size = round_up(i_size_read(inode), PAGE_CACHE_SIZE);
+	if ((i_size >> PAGE_CACHE_SHIFT) < pgoff + HPAGE_PMD_NR)
+		return VM_FAULT_FALLBACK;
+
+	if (unlikely(khugepaged_enter(vma)))
+		return VM_FAULT_OOM;
+
+	if (vma->vm_flags & VM_HUGEPAGE)
+		sgp = SGP_HUGE;
+	error = shmem_getpage(inode, linear_page_index(vma, address),
+			      &page, sgp, &ret);
+	if (error)
+		return ((error == -ENOMEM) ? VM_FAULT_OOM : VM_FAULT_SIGBUS);
+	unlock_page(page);
+	page_cache_release(page);
+
+	if (ret & VM_FAULT_MAJOR) {
+		count_vm_event(PGMAJFAULT);
+		mem_cgroup_count_vm_event(vma->vm_mm, PGMAJFAULT);
+	}
+	return ret | do_huge_pmd_file_page(vma->vm_mm, vma, address, pmd,
+					   inode->i_mapping, pgoff, flags);
+}
+#endif
+
 #ifdef CONFIG_NUMA
 static int shmem_set_policy(struct vm_area_struct *vma, struct mempolicy *mpol)
 {
@@ -2149,6 +2487,17 @@ static int shmem_parse_options(char *options, struct shmem_sb_info *sbinfo,
 		} else if (!strcmp(this_char,"mpol")) {
 			if (mpol_parse_str(value, &sbinfo->mpol, 1))
 				goto bad_val;
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+		} else if (!strcmp(this_char,"huge")) {
+			int huge;
+			huge = shmem_parse_huge(value);
+			if (huge < 0)
+				goto bad_val;
+			if (!has_transparent_hugepage() &&
+			    huge != SHMEM_HUGE_NEVER)
+				goto bad_val;
+			sbinfo->huge = huge;
+#endif
 		} else {
 			printk(KERN_ERR "tmpfs: Bad mount option %s\n",
 			       this_char);
@@ -2191,6 +2540,7 @@ static int shmem_remount_fs(struct super_block *sb, int *flags, char *data)
 		goto out;
 
 	error = 0;
+	sbinfo->huge = config.huge;
 	sbinfo->max_blocks  = config.max_blocks;
 	sbinfo->max_inodes  = config.max_inodes;
 	sbinfo->free_inodes = config.max_inodes - inodes;
@@ -2217,6 +2567,11 @@ static int shmem_show_options(struct seq_file *seq, struct dentry *root)
 		seq_printf(seq, ",uid=%u", sbinfo->uid);
 	if (sbinfo->gid != 0)
 		seq_printf(seq, ",gid=%u", sbinfo->gid);
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	/* Rightly or wrongly, show huge mount option unmasked by shmem_huge */
+	if (sbinfo->huge)
+		seq_printf(seq, ",huge=%s", shmem_format_huge(sbinfo->huge));
+#endif
 	shmem_show_mpol(seq, sbinfo->mpol);
 	return 0;
 }
@@ -2354,8 +2709,85 @@ static const struct address_space_operations shmem_aops = {
 	.error_remove_page = generic_error_remove_page,
 };
 
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+/*
+ * Choose an address whose offset within HPAGE_PMD_SIZE matches that of
+ * the file offset, so that shmem_pmd_fault can map whole teams: done by
+ * asking for a larger area and then trimming it to the right alignment.
+ */
+static unsigned long shmem_get_unmapped_area(struct file *file,
+				unsigned long uaddr, unsigned long len,
+				unsigned long pgoff, unsigned long flags)
+{
+	unsigned long (*get_area)(struct file *,
+		unsigned long, unsigned long, unsigned long, unsigned long);
+	unsigned long addr;
+	unsigned long offset;
+	unsigned long inflated_len;
+	unsigned long inflated_addr;
+	unsigned long inflated_offset;
+
+	if (len > TASK_SIZE)
+		return -ENOMEM;
+
+	get_area = current->mm->get_unmapped_area;
+	addr = get_area(file, uaddr, len, pgoff, flags);
+
+	if (IS_ERR_VALUE(addr))
+		return addr;
+	if (addr & ~PAGE_MASK)
+		return addr;
+	if (addr > TASK_SIZE - len)
+		return addr;
+
+	if (shmem_huge == SHMEM_HUGE_DENY)
+		return addr;
+	if (len < HPAGE_PMD_SIZE)
+		return addr;
+	if (flags & MAP_FIXED)
+		return addr;
+	/* If the caller specified an address hint, respect that as before */
+	if (uaddr)
+		return addr;
+
+	if (shmem_huge != SHMEM_HUGE_FORCE &&
+	    SHMEM_SB(file->f_path.dentry->d_sb)->huge == SHMEM_HUGE_NEVER)
+		return addr;
+
+	offset = (pgoff << PAGE_SHIFT) & (HPAGE_PMD_SIZE - 1);
+	if (offset && offset + len < 2 * HPAGE_PMD_SIZE)
+		return addr;
+	if ((addr & (HPAGE_PMD_SIZE - 1)) == offset)
+		return addr;
+
+	inflated_len = len + HPAGE_PMD_SIZE - PAGE_SIZE;
+	if (inflated_len > TASK_SIZE)
+		return addr;
+	if (inflated_len < len)
+		return addr;
+
+	inflated_addr = get_area(NULL, 0, inflated_len, 0, flags);
+	if (IS_ERR_VALUE(inflated_addr))
+		return addr;
+	if (inflated_addr & ~PAGE_MASK)
+		return addr;
+
+	inflated_offset = inflated_addr & (HPAGE_PMD_SIZE - 1);
+	inflated_addr += offset - inflated_offset;
+	if (inflated_offset > offset)
+		inflated_addr += HPAGE_PMD_SIZE;
+
+	if (inflated_addr > TASK_SIZE - len)
+		return addr;
+	return inflated_addr;
+}
+#endif
+
 static const struct file_operations shmem_file_operations = {
 	.mmap		= shmem_mmap,
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	.get_unmapped_area = shmem_get_unmapped_area,
+#endif
 #ifdef CONFIG_TMPFS
 	.llseek		= generic_file_llseek,
 	.read		= do_sync_read,
@@ -2429,6 +2861,10 @@ static const struct super_operations shmem_ops = {
 
 static const struct vm_operations_struct shmem_vm_ops = {
 	.fault		= shmem_fault,
+	.map_pages	= filemap_map_pages,
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	.pmd_fault	= shmem_pmd_fault,
+#endif
 #ifdef CONFIG_NUMA
 	.set_policy     = shmem_set_policy,
 	.get_policy     = shmem_get_policy,
@@ -2486,6 +2922,60 @@ out4:
 	return error;
 }
 
+#if defined(CONFIG_TRANSPARENT_HUGEPAGE) && defined(CONFIG_SYSFS)
+static ssize_t shmem_enabled_show(struct kobject *kobj,
+				  struct kobj_attribute *attr, char *buf)
+{
+	int values[] = {
+		SHMEM_HUGE_ALWAYS,
+		SHMEM_HUGE_WITHIN_SIZE,
+		SHMEM_HUGE_ADVISE,
+		SHMEM_HUGE_NEVER,
+		SHMEM_HUGE_DENY,
+		SHMEM_HUGE_FORCE,
+	};
+	int i, count;
+
+	for (i = 0, count = 0; i < ARRAY_SIZE(values); i++) {
+		const char *fmt = shmem_huge == values[i] ? "[%s] " : "%s ";
+
+		count += sprintf(buf + count, fmt,
+				 shmem_format_huge(values[i]));
+	}
+	buf[count - 1] = '\n';
+	return count;
+}
+
+static ssize_t shmem_enabled_store(struct kobject *kobj,
+		struct kobj_attribute *attr, const char *buf, size_t count)
+{
+	char tmp[16];
+	int huge;
+
+	if (count + 1 > sizeof(tmp))
+		return -EINVAL;
+	memcpy(tmp, buf, count);
+	tmp[count] = '\0';
+	if (count && tmp[count - 1] == '\n')
+		tmp[count - 1] = '\0';
+
+	huge = shmem_parse_huge(tmp);
+	if (huge == -EINVAL)
+		return -EINVAL;
+	if (!has_transparent_hugepage() &&
+	    huge != SHMEM_HUGE_NEVER && huge != SHMEM_HUGE_DENY)
+		return -EINVAL;
+
+	shmem_huge = huge;
+	if (shmem_huge > SHMEM_HUGE_DENY && !IS_ERR(shm_mnt))
+		SHMEM_SB(shm_mnt->mnt_sb)->huge = shmem_huge;
+	return count;
+}
+
+struct kobj_attribute shmem_enabled_attr =
+	__ATTR(shmem_enabled, 0644, shmem_enabled_show, shmem_enabled_store);
+#endif /* CONFIG_TRANSPARENT_HUGEPAGE && CONFIG_SYSFS */
+
 #else /* !CONFIG_SHMEM */
 
 /*
@@ -2520,6 +3010,11 @@ int shmem_unuse(swp_entry_t swap, struct page *page)
 	return 0;
 }
 
+bool shmem_mapping(struct address_space *mapping)
+{
+	return false;
+}
+
 int shmem_lock(struct file *file, int lock, struct user_struct *user)
 {
 	return 0;
@@ -39,6 +39,7 @@ int page_cluster;
 static DEFINE_PER_CPU(struct pagevec[NR_LRU_LISTS], lru_add_pvecs);
 static DEFINE_PER_CPU(struct pagevec, lru_rotate_pvecs);
 static DEFINE_PER_CPU(struct pagevec, lru_deactivate_pvecs);
+static DEFINE_PER_CPU(struct pagevec, lru_deactivate_anon_pvecs);
 
 /*
  * This path almost never happens for VM activity - pages are normally
@@ -365,6 +366,8 @@ void mark_page_accessed(struct page *page)
 			PageReferenced(page) && PageLRU(page)) {
 		activate_page(page);
 		ClearPageReferenced(page);
+		if (page_is_file_cache(page))
+			workingset_activation(page);
 	} else if (!PageReferenced(page)) {
 		SetPageReferenced(page);
 	}
@@ -491,6 +494,22 @@ static void lru_deactivate_fn(struct page *page, void *arg)
 	update_page_reclaim_stat(zone, page, file, 0);
 }
 
+static void lru_deactivate_anon_fn(struct page *page, void *arg)
+{
+	struct zone *zone = page_zone(page);
+
+	if (PageLRU(page) && PageActive(page) && PageSwapBacked(page) &&
+	    !PageUnevictable(page)) {
+		del_page_from_lru_list(zone, page, LRU_ACTIVE_ANON);
+		ClearPageActive(page);
+		ClearPageReferenced(page);
+		add_page_to_lru_list(zone, page, LRU_INACTIVE_ANON);
+
+		__count_vm_event(PGDEACTIVATE);
+		update_page_reclaim_stat(zone, page, 0, 0);
+	}
+}
+
 /*
  * Drain pages out of the cpu's pagevecs.
  * Either "cpu" is the current CPU, and preemption has already been
@@ -522,6 +541,10 @@ void lru_add_drain_cpu(int cpu)
 	if (pagevec_count(pvec))
 		pagevec_lru_move_fn(pvec, lru_deactivate_fn, NULL);
 
+	pvec = &per_cpu(lru_deactivate_anon_pvecs, cpu);
+	if (pagevec_count(pvec))
+		pagevec_lru_move_fn(pvec, lru_deactivate_anon_fn, NULL);
+
 	activate_page_drain(cpu);
 }
 
@@ -551,6 +574,25 @@ void deactivate_page(struct page *page)
 	}
 }
 
+/**
+ * deactivate_anon_page - move an anonymous page to the inactive list
+ * @page: page to deactivate
+ *
+ * Used for pages given up with MADV_FREE, so that reclaim finds them
+ * before the anonymous pages still in use.
+ */
+void deactivate_anon_page(struct page *page)
+{
+	if (PageLRU(page) && PageActive(page) && !PageUnevictable(page)) {
+		struct pagevec *pvec = &get_cpu_var(lru_deactivate_anon_pvecs);
+
+		page_cache_get(page);
+		if (!pagevec_add(pvec, page))
+			pagevec_lru_move_fn(pvec, lru_deactivate_anon_fn, NULL);
+		put_cpu_var(lru_deactivate_anon_pvecs);
+	}
+}
+
 void lru_add_drain(void)
 {
 	lru_add_drain_cpu(get_cpu());
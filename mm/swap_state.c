@@ -167,13 +167,18 @@ int add_to_swap(struct page *page)
 	 * deadlock in the swap out path.
 	 */
 	/*
-	 * Add it to the swap cache and mark it dirty
+	 * Add it to the swap cache.  The page is left clean: unmapping
+	 * moves any pte dirty bit to it, and a page that stays clean was
+	 * given up with MADV_FREE and need not be written out.
 	 */
 	err = add_to_swap_cache(page, entry,
 			__GFP_HIGH|__GFP_NOMEMALLOC|__GFP_NOWARN);
 
 	if (!err) {	/* Success */
+#ifdef __HAVE_ARCH_PAGE_TEST_AND_CLEAR_DIRTY
+		/* dirty state is in the storage key until the last unmap */
 		SetPageDirty(page);
+#endif
 		return 1;
 	} else {	/* -ENOMEM radix-tree allocation failure */
 		/*
@@ -183,6 +183,55 @@ int invalidate_inode_page(struct page *page)
 	return invalidate_complete_page(mapping, page);
 }
 
+/**
+ * clear_shadow_entries - remove shadow entries from a page cache range
+ * @mapping: mapping to clear
+ * @start: first index to clear
+ * @end: last index to clear (inclusive)
+ *
+ * Page reclaim leaves shadow entries behind in the slots of evicted
+ * pages (see mm/workingset.c).  These have to be dropped when the
+ * range they describe goes away, i.e. on truncation and when the
+ * inode is released.
+ *
+ * Pages in the range are left alone.
+ */
+void clear_shadow_entries(struct address_space *mapping,
+			  pgoff_t start, pgoff_t end)
+{
+	void **slots[PAGEVEC_SIZE];
+	void *entries[PAGEVEC_SIZE];
+	pgoff_t indices[PAGEVEC_SIZE];
+	pgoff_t index = start;
+	unsigned int nr, i;
+
+	while (index <= end && mapping->nrshadows) {
+		spin_lock_irq(&mapping->tree_lock);
+		nr = radix_tree_gang_lookup_slot(&mapping->page_tree, slots,
+						 indices, index, PAGEVEC_SIZE);
+		/* Deletion below may free the nodes holding these slots */
+		for (i = 0; i < nr; i++)
+			entries[i] = radix_tree_deref_slot_protected(slots[i],
+							&mapping->tree_lock);
+		for (i = 0; i < nr; i++) {
+			if (indices[i] > end)
+				break;
+			if (!radix_tree_exceptional_entry(entries[i]))
+				continue;
+			radix_tree_delete(&mapping->page_tree, indices[i]);
+			mapping->nrshadows--;
+		}
+		spin_unlock_irq(&mapping->tree_lock);
+
+		if (i < nr || nr < PAGEVEC_SIZE)
+			break;
+		index = indices[nr - 1] + 1;
+		if (!index)
+			break;
+		cond_resched();
+	}
+}
+
 /**
  * truncate_inode_pages_range - truncate range of pages specified by start & end byte offsets
  * @mapping: mapping to truncate
@@ -214,8 +263,16 @@ void truncate_inode_pages_range(struct address_space *mapping,
 	int i;
 
 	cleancache_invalidate_inode(mapping);
-	if (mapping->nrpages == 0)
-		return;
+	if (mapping->nrpages == 0) {
+		/*
+		 * Reclaim replaces the last page with a shadow entry and
+		 * only then drops nrpages; pairs with the smp_wmb() in
+		 * page_cache_tree_delete().
+		 */
+		smp_rmb();
+		if (mapping->nrshadows == 0)
+			return;
+	}
 
 	BUG_ON((lend & (PAGE_CACHE_SIZE - 1)) != (PAGE_CACHE_SIZE - 1));
 	end = (lend >> PAGE_CACHE_SHIFT);
@@ -292,6 +349,7 @@ void truncate_inode_pages_range(struct address_space *mapping,
 		mem_cgroup_uncharge_end();
 		index++;
 	}
+	clear_shadow_entries(mapping, start, end);
 	cleancache_invalidate_inode(mapping);
 }
 EXPORT_SYMBOL(truncate_inode_pages_range);
@@ -401,7 +459,7 @@ invalidate_complete_page2(struct address_space *mapping, struct page *page)
 		goto failed;
 
 	BUG_ON(page_has_private(page));
-	__delete_from_page_cache(page);
+	__delete_from_page_cache(page, NULL);
 	spin_unlock_irq(&mapping->tree_lock);
 	mem_cgroup_uncharge_cache_page(page);
 
@@ -602,6 +602,24 @@ int fragmentation_index(struct zone *zone, unsigned int order)
 	fill_contig_page_info(zone, order, &info);
 	return __fragmentation_index(order, &info);
 }
+
+/*
+ * External fragmentation of a zone with respect to the given order:
+ * the percentage of free pages that sit in blocks smaller than
+ * 1 << order.  Ranges from 0 to 100.
+ */
+unsigned int extfrag_for_order(struct zone *zone, unsigned int order)
+{
+	struct contig_page_info info;
+
+	fill_contig_page_info(zone, order, &info);
+	if (!info.free_pages)
+		return 0;
+
+	return div_u64((info.free_pages -
+			(info.free_blocks_suitable << order)) * 100,
+			info.free_pages);
+}
 #endif
 
 #if defined(CONFIG_PROC_FS) || defined(CONFIG_COMPACTION)
@@ -718,6 +736,8 @@ const char * const vmstat_text[] = {
 	"numa_local",
 	"numa_other",
 #endif
+	"workingset_refault",
+	"workingset_activate",
 	"nr_anon_transparent_hugepages",
 	"nr_dirty_threshold",
 	"nr_dirty_background_threshold",
@@ -736,6 +756,8 @@ const char * const vmstat_text[] = {
 
 	"pgfault",
 	"pgmajfault",
+	"pgfaultaround",
+	"pgfaultaround_mapped",
 
 	TEXTS_FOR_ZONES("pgrefill")
 	TEXTS_FOR_ZONES("pgsteal_kswapd")
@@ -756,6 +778,14 @@ const char * const vmstat_text[] = {
 	"allocstall",
 
 	"pgrotated",
+	"pglazyfreed",
+
+#ifdef CONFIG_NUMA_BALANCING
+	"numa_pte_updates",
+	"numa_hint_faults",
+	"numa_hint_faults_local",
+	"numa_pages_migrated",
+#endif
 
 #ifdef CONFIG_COMPACTION
 	"compact_blocks_moved",
@@ -764,6 +794,10 @@ const char * const vmstat_text[] = {
 	"compact_stall",
 	"compact_fail",
 	"compact_success",
+	"compact_daemon_wake",
+	"compact_daemon_proactive",
+	"compact_daemon_migrated",
+	"compact_daemon_time_us",
 #endif
 
 #ifdef CONFIG_HUGETLB_PAGE
@@ -785,6 +819,9 @@ const char * const vmstat_text[] = {
 	"thp_collapse_alloc",
 	"thp_collapse_alloc_failed",
 	"thp_split",
+	"thp_file_alloc",
+	"thp_file_fallback",
+	"thp_file_mapped",
 #endif
 
 #endif /* CONFIG_VM_EVENTS_COUNTERS */
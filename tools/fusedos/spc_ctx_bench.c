@@ -0,0 +1,283 @@
+/*
+ * spc_ctx_bench: spc_context_t signalling latency
+ *
+ * Maps an array of spc_context_t into shared memory and runs, per
+ * context, one thread standing in for the CL and one for the SPC.  The
+ * CL posts commands through command/start and waits for start to drop;
+ * the SPC polls start, answers and keeps its own status words busy the
+ * way the SPC monitor does.  Optionally a second CL thread hammers the
+ * ipi_message line.  Reports the layout of the hot fields and the
+ * round-trip latency, so a layout change can be checked for lines
+ * shared between writers and measured.
+ *
+ * authors:
+ *    Yoonho Park <yoonho@us.ibm.com>
+ *    Eric Van Hensbergen <ericvh@gmail.com>
+ *    Marius Hillenbrand <mlhillen@us.ibm.com>
+ *
+ * This software is available to you under the GNU General Public
+ * License (GPL) version 2.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#include "fusedos.h"
+
+struct pair {
+	spc_context_t *sc;
+	int cl_cpu;
+	int spc_cpu;
+	int noise_cpu;
+	unsigned long iters;
+	uint64_t *lat;		/* ns per round trip */
+	volatile int done;
+};
+
+static int opt_noise;
+
+static void pin(int cpu)
+{
+	cpu_set_t set;
+
+	if (cpu < 0)
+		return;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if (sched_setaffinity(0, sizeof(set), &set))
+		perror("sched_setaffinity");
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Same protocol as the SPC monitor and drivers/fusedos/spc_emu.c */
+static void *spc_thread(void *arg)
+{
+	struct pair *p = arg;
+	spc_context_t *sc = p->sc;
+
+	pin(p->spc_cpu);
+	while (!p->done) {
+		/* status words the SPC updates while it runs */
+		sc->ppr32++;
+		sc->spcm_sp++;
+		if (!sc->start)
+			continue;
+		spc_ring_rmb();
+		sc->ex_code = sc->command;
+		sc->ipi_wakeup++;
+		spc_ring_wmb();
+		sc->start = 0;
+	}
+	return NULL;
+}
+
+/* A second CL thread talking to the SPC through ipi_message */
+static void *noise_thread(void *arg)
+{
+	struct pair *p = arg;
+
+	pin(p->noise_cpu);
+	while (!p->done)
+		p->sc->ipi_message.parm1++;
+	return NULL;
+}
+
+static void *cl_thread(void *arg)
+{
+	struct pair *p = arg;
+	spc_context_t *sc = p->sc;
+	unsigned long i;
+	uint64_t t;
+
+	pin(p->cl_cpu);
+	for (i = 0; i < p->iters; i++) {
+		t = now_ns();
+		sc->command = SPC_RESUME;
+		spc_ring_wmb();
+		sc->start = 1;
+		while (sc->start)
+			;
+		p->lat[i] = now_ns() - t;
+	}
+	p->done = 1;
+	return NULL;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+#define FIELD(f) { #f, offsetof(spc_context_t, f), \
+		   sizeof(((spc_context_t *)0)->f) }
+static const struct {
+	const char *name;
+	size_t off;
+	size_t size;
+} fields[] = {
+	FIELD(abi_version),
+	FIELD(start),
+	FIELD(command),
+	FIELD(ppr32),
+	FIELD(ipi_wakeup),
+	FIELD(ex_code),
+	FIELD(spcm_sp),
+	FIELD(ipi_message),
+	FIELD(cmd_ring),
+	FIELD(tlb_entry_count),
+	FIELD(tlb_dirty),
+	FIELD(tlb_entry),
+	FIELD(tlb_entry_install),
+	FIELD(spcm_stack),
+	FIELD(scratch),
+};
+
+static void print_layout(void)
+{
+	size_t i;
+
+	printf("spc_context_t ABI %d, %zu bytes, %d-byte lines\n",
+	       SPC_CONTEXT_ABI_VERSION, sizeof(spc_context_t),
+	       SPC_CONTEXT_LINE);
+	printf("%-20s %8s %8s %6s\n", "field", "offset", "size", "line");
+	for (i = 0; i < sizeof(fields) / sizeof(fields[0]); i++)
+		printf("%-20s %8zu %8zu %6zu\n", fields[i].name,
+		       fields[i].off, fields[i].size,
+		       fields[i].off / SPC_CONTEXT_LINE);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-n iterations] [-p pairs] [-c first-cpu] [-i] [-l]\n"
+		"  -c  pair i uses CPUs first-cpu + 3i (CL), + 3i + 1 (SPC)\n"
+		"      and + 3i + 2 (-i thread)\n"
+		"  -i  add a CL thread writing ipi_message\n"
+		"  -l  print the layout and exit\n", prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long iters = 100000;
+	int nr = 1;
+	int cpu = -1;
+	struct pair *pairs;
+	spc_context_t *ctx;
+	pthread_t *th;
+	size_t sz;
+	int c;
+	int i;
+
+	while ((c = getopt(argc, argv, "n:p:c:il")) != -1) {
+		switch (c) {
+		case 'n':
+			iters = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			nr = atoi(optarg);
+			break;
+		case 'c':
+			cpu = atoi(optarg);
+			break;
+		case 'i':
+			opt_noise = 1;
+			break;
+		case 'l':
+			print_layout();
+			return 0;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (nr < 1 || iters < 1)
+		usage(argv[0]);
+
+	print_layout();
+
+	sz = nr * sizeof(spc_context_t);
+	ctx = mmap(NULL, sz, PROT_READ | PROT_WRITE,
+		   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (ctx == MAP_FAILED) {
+		perror("mmap");
+		return 1;
+	}
+	memset(ctx, 0, sz);
+
+	pairs = calloc(nr, sizeof(*pairs));
+	th = calloc(nr * 3, sizeof(*th));
+	if (!pairs || !th) {
+		perror("calloc");
+		return 1;
+	}
+
+	for (i = 0; i < nr; i++) {
+		struct pair *p = &pairs[i];
+
+		ctx[i].abi_version = SPC_CONTEXT_ABI_VERSION;
+		ctx[i].abi_size = sizeof(spc_context_t);
+		ctx[i].id = i;
+		p->sc = &ctx[i];
+		p->iters = iters;
+		p->cl_cpu = cpu < 0 ? -1 : cpu + 3 * i;
+		p->spc_cpu = cpu < 0 ? -1 : cpu + 3 * i + 1;
+		p->noise_cpu = cpu < 0 ? -1 : cpu + 3 * i + 2;
+		p->lat = calloc(iters, sizeof(*p->lat));
+		if (!p->lat) {
+			perror("calloc");
+			return 1;
+		}
+		pthread_create(&th[3 * i], NULL, spc_thread, p);
+		if (opt_noise)
+			pthread_create(&th[3 * i + 2], NULL, noise_thread, p);
+		pthread_create(&th[3 * i + 1], NULL, cl_thread, p);
+	}
+
+	printf("\n%-5s %10s %10s %10s %10s %10s (ns)\n",
+	       "pair", "min", "avg", "p50", "p99", "max");
+	for (i = 0; i < nr; i++) {
+		struct pair *p = &pairs[i];
+		uint64_t sum = 0;
+		unsigned long n;
+
+		pthread_join(th[3 * i + 1], NULL);
+		pthread_join(th[3 * i], NULL);
+		if (opt_noise)
+			pthread_join(th[3 * i + 2], NULL);
+
+		for (n = 0; n < iters; n++)
+			sum += p->lat[n];
+		qsort(p->lat, iters, sizeof(*p->lat), cmp_u64);
+		printf("%-5d %10llu %10llu %10llu %10llu %10llu\n", i,
+		       (unsigned long long)p->lat[0],
+		       (unsigned long long)(sum / iters),
+		       (unsigned long long)p->lat[iters / 2],
+		       (unsigned long long)p->lat[iters * 99 / 100],
+		       (unsigned long long)p->lat[iters - 1]);
+		free(p->lat);
+	}
+
+	munmap(ctx, sz);
+	free(th);
+	free(pairs);
+	return 0;
+}
@@ -0,0 +1,460 @@
+/*
+ *
+ * sched-latency.c
+ *
+ * latency: Benchmark for wakeup latency of the scheduler
+ *
+ * Message threads periodically wake up a set of worker threads each and
+ * the workers measure the time from the wakeup until they actually run,
+ * like schbench by Chris Mason does.  Unlike the throughput oriented
+ * messaging and pipe suites this reports the latency distribution.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../util/cpumap.h"
+#include "../util/sysfs.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/types.h>
+#include <linux/futex.h>
+
+static unsigned int message_threads = 2;
+static unsigned int worker_threads = 16;
+static unsigned int runtime = 5;
+static unsigned int sleeptime = 10000;
+static unsigned int cputime = 100;
+static const char *cpu_list;
+static const char *smt_str;
+static bool pin;
+
+static const struct option options[] = {
+	OPT_UINTEGER('m', "message-threads", &message_threads,
+		     "Specify number of message threads"),
+	OPT_UINTEGER('t', "threads", &worker_threads,
+		     "Specify number of worker threads per message thread"),
+	OPT_UINTEGER('r', "runtime", &runtime,
+		     "Specify runtime in seconds"),
+	OPT_UINTEGER('s', "sleeptime", &sleeptime,
+		     "Specify usecs message threads sleep between wakeups"),
+	OPT_UINTEGER('c', "cputime", &cputime,
+		     "Specify usecs workers spin after each wakeup"),
+	OPT_STRING('C', "cpu", &cpu_list, "cpu",
+		   "list of cpus to run on (default: all online cpus)"),
+	OPT_BOOLEAN('p', "pin", &pin,
+		    "pin every thread to a single cpu"),
+	OPT_STRING(0, "smt", &smt_str, "spread|pack",
+		   "placement of pinned threads on SMT siblings"),
+	OPT_END()
+};
+
+static const char * const bench_sched_latency_usage[] = {
+	"perf bench sched latency <options>",
+	NULL
+};
+
+/*
+ * Latencies are kept in usecs in a log-linear histogram: values below
+ * 2 * LAT_VALS are exact, above that every power of two is split into
+ * LAT_VALS buckets, which keeps the error of a percentile below 3%.
+ */
+#define LAT_BITS	5
+#define LAT_VALS	(1 << LAT_BITS)
+#define LAT_GROUPS	22
+#define LAT_NR		(LAT_GROUPS * LAT_VALS)
+
+static unsigned int lat_to_idx(u64 usec)
+{
+	unsigned int msb, shift, idx;
+
+	if (usec < 2 * LAT_VALS)
+		return usec;
+
+	msb = 63 - __builtin_clzll(usec);
+	shift = msb - LAT_BITS;
+	idx = (shift + 1) * LAT_VALS + ((usec >> shift) & (LAT_VALS - 1));
+
+	return min(idx, (unsigned int)LAT_NR - 1);
+}
+
+static u64 idx_to_lat(unsigned int idx)
+{
+	unsigned int shift;
+
+	if (idx < 2 * LAT_VALS)
+		return idx;
+
+	shift = idx / LAT_VALS - 1;
+
+	return (1ULL << (shift + LAT_BITS)) +
+	       ((u64)(idx % LAT_VALS) << shift);
+}
+
+enum {
+	WORKER_BLOCKED,
+	WORKER_RUNNING,
+};
+
+struct worker {
+	pthread_t		thread;
+	/* only the message thread moves BLOCKED -> RUNNING, only we go back */
+	int			futex;
+	u64			wake_time;
+	int			cpu;
+	u64			nr_samples;
+	u64			max;
+	u64			hist[LAT_NR];
+};
+
+struct message {
+	pthread_t		thread;
+	int			cpu;
+	struct worker		*workers;
+};
+
+static volatile int stop;
+
+static int futex(int *uaddr, int op, int val)
+{
+	return syscall(__NR_futex, uaddr, op, val, NULL, NULL, 0);
+}
+
+static u64 now_usec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (u64)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static void bind_cpu(int cpu)
+{
+	cpu_set_t set;
+
+	if (cpu < 0)
+		return;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if (sched_setaffinity(0, sizeof(set), &set) < 0)
+		fprintf(stderr, "sched_setaffinity() to cpu %d failed: %s\n",
+			cpu, strerror(errno));
+}
+
+/* Threads created afterwards inherit the mask */
+static void bind_map(struct cpu_map *map)
+{
+	cpu_set_t set;
+	int i;
+
+	CPU_ZERO(&set);
+	for (i = 0; i < map->nr; i++)
+		CPU_SET(map->map[i], &set);
+	if (sched_setaffinity(0, sizeof(set), &set) < 0)
+		fprintf(stderr, "sched_setaffinity() to cpus %s failed: %s\n",
+			cpu_list, strerror(errno));
+}
+
+static void spin(unsigned int usecs)
+{
+	u64 end = now_usec() + usecs;
+
+	while (now_usec() < end)
+		;
+}
+
+static void *worker_thread(void *arg)
+{
+	struct worker *w = arg;
+	u64 delta;
+
+	bind_cpu(w->cpu);
+
+	for (;;) {
+		w->futex = WORKER_BLOCKED;
+		__sync_synchronize();
+		if (stop)
+			break;
+
+		while (w->futex == WORKER_BLOCKED)
+			futex(&w->futex, FUTEX_WAIT_PRIVATE, WORKER_BLOCKED);
+		if (stop)
+			break;
+
+		delta = now_usec() - w->wake_time;
+		w->hist[lat_to_idx(delta)]++;
+		w->nr_samples++;
+		if (delta > w->max)
+			w->max = delta;
+
+		spin(cputime);
+	}
+
+	return NULL;
+}
+
+static void wake_worker(struct worker *w)
+{
+	w->wake_time = now_usec();
+	__sync_synchronize();
+	w->futex = WORKER_RUNNING;
+	futex(&w->futex, FUTEX_WAKE_PRIVATE, 1);
+}
+
+static void *message_thread(void *arg)
+{
+	struct message *msg = arg;
+	unsigned int i;
+
+	bind_cpu(msg->cpu);
+
+	while (!stop) {
+		usleep(sleeptime);
+
+		/* a worker still busy with the last round misses this one */
+		for (i = 0; i < worker_threads; i++) {
+			if (msg->workers[i].futex == WORKER_BLOCKED)
+				wake_worker(&msg->workers[i]);
+		}
+	}
+
+	for (i = 0; i < worker_threads; i++)
+		wake_worker(&msg->workers[i]);
+
+	return NULL;
+}
+
+struct cpu_topo {
+	int cpu;
+	int package;
+	int core;
+	int sibling;
+};
+
+static int read_topology_id(int cpu, const char *name)
+{
+	const char *sysfs = sysfs_find_mountpoint();
+	char path[PATH_MAX];
+	FILE *fp;
+	int id;
+
+	if (!sysfs)
+		return -1;
+
+	snprintf(path, sizeof(path), "%s/devices/system/cpu/cpu%d/topology/%s",
+		 sysfs, cpu, name);
+	fp = fopen(path, "r");
+	if (!fp)
+		return -1;
+	if (fscanf(fp, "%d", &id) != 1)
+		id = -1;
+	fclose(fp);
+
+	return id;
+}
+
+/* pack: siblings of a core next to each other */
+static int topo_cmp_pack(const void *a, const void *b)
+{
+	const struct cpu_topo *x = a, *y = b;
+
+	if (x->package != y->package)
+		return x->package - y->package;
+	if (x->core != y->core)
+		return x->core - y->core;
+	return x->cpu - y->cpu;
+}
+
+/* spread: one thread of every core first, then the next siblings */
+static int topo_cmp_spread(const void *a, const void *b)
+{
+	const struct cpu_topo *x = a, *y = b;
+
+	if (x->sibling != y->sibling)
+		return x->sibling - y->sibling;
+	return topo_cmp_pack(a, b);
+}
+
+/*
+ * Order the cpus of @map in which threads get pinned to them.
+ */
+static int order_cpus(struct cpu_map *map, bool spread)
+{
+	struct cpu_topo *topo;
+	int i, j;
+
+	topo = calloc(map->nr, sizeof(*topo));
+	if (!topo)
+		return -ENOMEM;
+
+	for (i = 0; i < map->nr; i++) {
+		topo[i].cpu = map->map[i];
+		topo[i].package = read_topology_id(map->map[i],
+						   "physical_package_id");
+		topo[i].core = read_topology_id(map->map[i], "core_id");
+		/* without topology every cpu is a core of its own */
+		if (topo[i].core < 0)
+			topo[i].core = map->map[i];
+
+		for (j = 0; j < i; j++) {
+			if (topo[j].package == topo[i].package &&
+			    topo[j].core == topo[i].core)
+				topo[i].sibling++;
+		}
+	}
+
+	qsort(topo, map->nr, sizeof(*topo),
+	      spread ? topo_cmp_spread : topo_cmp_pack);
+
+	for (i = 0; i < map->nr; i++)
+		map->map[i] = topo[i].cpu;
+
+	free(topo);
+	return 0;
+}
+
+static void print_result(u64 *hist, u64 nr_samples, u64 max)
+{
+	static const double percentiles[] = { 50.0, 90.0, 99.0, 99.9 };
+	u64 values[ARRAY_SIZE(percentiles)];
+	unsigned int i, p = 0;
+	u64 seen = 0;
+
+	memset(values, 0, sizeof(values));
+	for (i = 0; i < LAT_NR && p < ARRAY_SIZE(percentiles); i++) {
+		seen += hist[i];
+		while (p < ARRAY_SIZE(percentiles) &&
+		       seen && seen >= nr_samples * percentiles[p] / 100.0)
+			values[p++] = idx_to_lat(i);
+	}
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %u message threads, %u workers each, %u sec\n\n",
+		       message_threads, worker_threads, runtime);
+		printf(" Wakeup latency percentiles (usec), %" PRIu64
+		       " samples\n", nr_samples);
+		for (i = 0; i < ARRAY_SIZE(percentiles); i++)
+			printf(" %14.1fth: %" PRIu64 "\n",
+			       percentiles[i], values[i]);
+		printf(" %16s: %" PRIu64 "\n", "max", max);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		for (i = 0; i < ARRAY_SIZE(percentiles); i++)
+			printf("%" PRIu64 " ", values[i]);
+		printf("%" PRIu64 "\n", max);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+}
+
+int bench_sched_latency(int argc, const char **argv,
+			const char *prefix __used)
+{
+	struct message *messages;
+	struct worker *workers;
+	struct cpu_map *map;
+	unsigned int i, j, nr_workers;
+	u64 *hist, nr_samples = 0, max = 0;
+	int next_cpu = 0;
+
+	argc = parse_options(argc, argv, options,
+			     bench_sched_latency_usage, 0);
+
+	if (!message_threads || !worker_threads) {
+		fprintf(stderr, "Need at least one message and worker thread\n");
+		return -1;
+	}
+
+	if (smt_str && strcmp(smt_str, "spread") && strcmp(smt_str, "pack")) {
+		fprintf(stderr, "Unknown SMT placement: %s\n", smt_str);
+		usage_with_options(bench_sched_latency_usage, options);
+	}
+
+	map = cpu_map__new(cpu_list);
+	if (!map) {
+		fprintf(stderr, "Invalid cpu list: %s\n", cpu_list);
+		return -1;
+	}
+
+	if (order_cpus(map, !smt_str || !strcmp(smt_str, "spread")))
+		die("no memory");
+
+	if (!pin && cpu_list)
+		bind_map(map);
+
+	nr_workers = message_threads * worker_threads;
+	messages = calloc(message_threads, sizeof(*messages));
+	workers = calloc(nr_workers, sizeof(*workers));
+	hist = calloc(LAT_NR, sizeof(*hist));
+	if (!messages || !workers || !hist)
+		die("no memory");
+
+	/*
+	 * Pinned, every message thread takes the next cpu and its workers
+	 * the ones after it, wrapping around when there are more threads
+	 * than cpus.
+	 */
+	for (i = 0; i < message_threads; i++) {
+		struct message *msg = &messages[i];
+
+		msg->workers = &workers[i * worker_threads];
+		msg->cpu = pin ? map->map[next_cpu++ % map->nr] : -1;
+
+		for (j = 0; j < worker_threads; j++) {
+			struct worker *w = &msg->workers[j];
+
+			w->cpu = pin ? map->map[next_cpu++ % map->nr] : -1;
+			w->futex = WORKER_RUNNING;
+			if (pthread_create(&w->thread, NULL, worker_thread, w))
+				die("pthread_create failed");
+		}
+
+		if (pthread_create(&msg->thread, NULL, message_thread, msg))
+			die("pthread_create failed");
+	}
+
+	sleep(runtime);
+	stop = 1;
+
+	for (i = 0; i < message_threads; i++)
+		pthread_join(messages[i].thread, NULL);
+
+	for (i = 0; i < nr_workers; i++) {
+		struct worker *w = &workers[i];
+
+		pthread_join(w->thread, NULL);
+		for (j = 0; j < LAT_NR; j++)
+			hist[j] += w->hist[j];
+		nr_samples += w->nr_samples;
+		if (w->max > max)
+			max = w->max;
+	}
+
+	print_result(hist, nr_samples, max);
+
+	free(hist);
+	free(workers);
+	free(messages);
+	cpu_map__delete(map);
+
+	return 0;
+}
@@ -42,6 +42,9 @@ static struct bench_suite sched_suites[] = {
 	{ "pipe",
 	  "Flood of communication over pipe() between two processes",
 	  bench_sched_pipe      },
+	{ "latency",
+	  "Wakeup latency percentiles of message and worker threads",
+	  bench_sched_latency   },
 	suite_all,
 	{ NULL,
 	  NULL,
@@ -13,6 +13,9 @@ void get_term_dimensions(struct winsize *ws);
 #ifndef __NR_perf_event_open
 # define __NR_perf_event_open 336
 #endif
+#ifndef __NR_futex
+# define __NR_futex 240
+#endif
 #endif
 
 #if defined(__x86_64__)
@@ -23,6 +26,9 @@ void get_term_dimensions(struct winsize *ws);
 #ifndef __NR_perf_event_open
 # define __NR_perf_event_open 298
 #endif
+#ifndef __NR_futex
+# define __NR_futex 202
+#endif
 #endif
 
 #ifdef __powerpc__
@@ -30,6 +36,9 @@ void get_term_dimensions(struct winsize *ws);
 #define rmb()		asm volatile ("sync" ::: "memory")
 #define cpu_relax()	asm volatile ("" ::: "memory");
 #define CPUINFO_PROC	"cpu"
+#ifndef __NR_futex
+# define __NR_futex 221
+#endif
 #endif
 
 #ifdef __s390__